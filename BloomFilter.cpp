@@ -0,0 +1,104 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#include "BloomFilter.h"
+
+namespace FileSystem {
+
+    BloomFilter::BloomFilter(u_int64 byteSize) : _bits(byteSize, 0) {}
+
+    BloomFilter BloomFilter::forEntries(u_int64 entries) {
+        auto byteSize = (entries * BITS_PER_ENTRY + 7) / 8;
+        return BloomFilter{byteSize > SLOT_BITS_SIZE ? byteSize : SLOT_BITS_SIZE};
+    }
+
+    BloomFilter BloomFilter::parse(ByteArray bytes) {
+        assert(bytes.size() >= HEADER_SIZE, "BloomFilter::parse", "过滤器数据不完整");
+
+        auto byteSize = IByteable::fromBytes<unsigned int>(bytes.subByte(0, 4));
+
+        if (byteSize == 0 || HEADER_SIZE + byteSize > bytes.size()) {
+            return BloomFilter{0};
+        }
+
+        BloomFilter res{byteSize};
+        res.count = IByteable::fromBytes<unsigned int>(bytes.subByte(4, 8));
+        res.removed = IByteable::fromBytes<unsigned int>(bytes.subByte(8, 12));
+        std::memcpy(res._bits.data(), bytes.data() + HEADER_SIZE, byteSize);
+        return res;
+    }
+
+    ByteArray BloomFilter::toBytes() {
+        // 放不进槽位的过滤器只保留在内存中，槽位标记为无效
+        auto byteSize = fitsSlot() ? static_cast<unsigned int>(_bits.size()) : 0;
+
+        auto res = ByteArray()
+                .append(IByteable::toBytes(byteSize))
+                .append(IByteable::toBytes(count))
+                .append(IByteable::toBytes(removed));
+
+        if (byteSize != 0) {
+            res.append(reinterpret_cast<const std::byte *>(_bits.data()), byteSize);
+        }
+
+        while (res.size() < SLOT_SIZE) res.append(std::byte{0});
+
+        return res;
+    }
+
+    static std::pair<u_int64, u_int64> nameHash(const std::string &name) {
+        // FNV-1a 64 位，高低 32 位用于双重哈希
+        u_int64 hash = 0xcbf29ce484222325ULL;
+        for (unsigned char ch: name) {
+            hash ^= ch;
+            hash *= 0x100000001b3ULL;
+        }
+        return {hash & 0xFFFFFFFF, (hash >> 32) | 1};
+    }
+
+    void BloomFilter::add(const std::string &name) {
+        if (_bits.empty()) return;
+        auto [h1, h2] = nameHash(name);
+        auto bitSize = _bits.size() * 8;
+        for (int i = 0; i < HASH_COUNT; ++i) {
+            auto bit = (h1 + i * h2) % bitSize;
+            _bits[bit / 8] |= static_cast<unsigned char>(1 << (bit % 8));
+        }
+        count++;
+    }
+
+    bool BloomFilter::mayContain(const std::string &name) const {
+        if (_bits.empty()) return true;
+        auto [h1, h2] = nameHash(name);
+        auto bitSize = _bits.size() * 8;
+        for (int i = 0; i < HASH_COUNT; ++i) {
+            auto bit = (h1 + i * h2) % bitSize;
+            if ((_bits[bit / 8] & (1 << (bit % 8))) == 0) return false;
+        }
+        return true;
+    }
+
+    void BloomFilter::markRemoved() {
+        removed++;
+    }
+
+    bool BloomFilter::valid() const {
+        return !_bits.empty();
+    }
+
+    bool BloomFilter::stale() const {
+        return !valid()
+               || removed * 2 > count
+               || (u_int64) count * BITS_PER_ENTRY > _bits.size() * 8 * 2;
+    }
+
+    bool BloomFilter::fitsSlot() const {
+        return _bits.size() <= SLOT_BITS_SIZE;
+    }
+
+    u_int64 BloomFilter::byteSize() const {
+        return _bits.size();
+    }
+
+} // FileSystem
@@ -0,0 +1,61 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#ifndef FILESYSTEM_BLOOMFILTER_H
+#define FILESYSTEM_BLOOMFILTER_H
+
+#include "Utils.h"
+
+namespace FileSystem {
+
+    /**
+     * 目录名称过滤器（布隆过滤器）
+     *
+     * 持久化格式： | 位图字节数 4 字节 | 插入次数 4 字节 | 删除次数 4 字节 | 位图 |
+     * 持久化时占用固定的 128 字节槽位，位图字节数为 0 表示槽位中的内容无效，需要重建
+     *
+     * 删除项目时无法从位图中移除名称，只记录删除次数，删除过多时视为过期并重建
+     */
+    class BloomFilter : IByteable {
+    public:
+
+        const static u_int64 SLOT_SIZE = 128;
+        const static u_int64 HEADER_SIZE = 12;
+        const static u_int64 SLOT_BITS_SIZE = SLOT_SIZE - HEADER_SIZE;
+        const static u_int64 BITS_PER_ENTRY = 10;
+        const static int HASH_COUNT = 4;
+
+        explicit BloomFilter(u_int64 byteSize = SLOT_BITS_SIZE);
+
+        static BloomFilter forEntries(u_int64 entries);
+
+        static BloomFilter parse(ByteArray bytes);
+
+        ByteArray toBytes() override;
+
+        void add(const std::string &name);
+
+        [[nodiscard]] bool mayContain(const std::string &name) const;
+
+        void markRemoved();
+
+        [[nodiscard]] bool valid() const;
+
+        [[nodiscard]] bool stale() const;
+
+        [[nodiscard]] bool fitsSlot() const;
+
+        [[nodiscard]] u_int64 byteSize() const;
+
+        unsigned int count{};
+        unsigned int removed{};
+
+    private:
+
+        std::vector<unsigned char> _bits{};
+    };
+
+} // FileSystem
+
+#endif //FILESYSTEM_BLOOMFILTER_H
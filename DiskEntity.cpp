@@ -6,18 +6,25 @@
 
 #include <utility>
 #include <fstream>
+#include <filesystem>
+#include <algorithm>
 #include "FileNode.h"
 #include "EmptyNode.h"
 #include "SHA256.h"
 
 namespace FileSystem {
 
-    void DiskEntity::format(u_int64 diskSize, const std::string &root_password) {
+    void DiskEntity::format(u_int64 diskSize, const std::string &root_password, u_int64 features) {
+
+        _legacy = false;
+        _features = features;
+        _packThreshold = 0;
+        _fileIndexStart = FILE_INDEX_START;
 
         ByteArray prefix = ByteArray()
 
                 // 文件系统标识
-                .append(reinterpret_cast<const std::byte *>("SakulinF"), 8)
+                .append(reinterpret_cast<const std::byte *>("SakulinX"), 8)
 
                         // 磁盘大小
                 .append(IByteable::toBytes(diskSize))
@@ -32,19 +39,29 @@ namespace FileSystem {
                 .append(reinterpret_cast<const std::byte *>(Ly::Sha256::getInstance().getHexMessageDigest(
                         root_password).data()), 32)
 
+                        // 特性标志
+                .append(IByteable::toBytes(_features))
+
+                        // 保留
+                .append(ByteArray(std::vector<std::byte>(FILE_INDEX_START - FEATURES_START - 8).data(),
+                                  FILE_INDEX_START - FEATURES_START - 8))
+
                         // 文件数据（初始时全空）
-                .append(EmptyNode(UNDEFINED, UNDEFINED, diskSize - FILE_INDEX_START, UNDEFINED, UNDEFINED).toBytes());
+                .append(EmptyNode(UNDEFINED, UNDEFINED, diskSize - FILE_INDEX_START, UNDEFINED, UNDEFINED,
+                                  compactOffsets()).toBytes());
 
         _fileLinker.doWithFileO(0, 0, [&](std::ofstream &it) {
             it.write(reinterpret_cast<const char *>(prefix.data()), (std::streamsize) prefix.size());
         });
     }
 
-    DiskEntity::DiskEntity(u_int64 size, std::string path, const std::string &root_password) : _fileLinker(
-            std::move(path)) {
+    DiskEntity::DiskEntity(u_int64 size, std::string path, const std::string &root_password, u_int64 features)
+            : _fileLinker(std::move(path)) {
+        assert((features & FEATURE_COMPACT_OFFSETS) == 0 || size <= COMPACT_MAX_SIZE, "DiskEntity::DiskEntity",
+               "紧凑格式的镜像不能超过 4GB");
         _fileLinker.create();
         _fileLinker.resize(size);
-        format(size, root_password);
+        format(size, root_password, features);
     }
 
     DiskEntity::DiskEntity(std::string path) : _fileLinker(path) {
@@ -52,61 +69,324 @@ namespace FileSystem {
     }
 
 
-    u_int64 DiskEntity::addFile(const INode &iNode, ByteArray byteArray) {
+    u_int64 DiskEntity::addFile(const INode &iNode, const ByteArray &byteArray, u_int64 near) {
+        auto position = splitMetadata() ? allocateSplit(iNode, &byteArray, near) : allocate(iNode, &byteArray, near);
+
+        // 没有足够大的连续空闲区域时，普通文件改为分段存储
+        if (position == UNDEFINED && iNode.type == INode::FILE_TYPE) position = allocateExtents(iNode, &byteArray);
+
+        return position;
+    }
+
+    u_int64 DiskEntity::reserveFile(const INode &iNode, u_int64 near) {
+        auto position = splitMetadata() ? allocateSplit(iNode, nullptr, near) : allocate(iNode, nullptr, near);
+
+        if (position == UNDEFINED && iNode.type == INode::FILE_TYPE) position = allocateExtents(iNode, nullptr);
+
+        return position;
+    }
+
+    u_int64 DiskEntity::allocateSplit(const INode &iNode, const ByteArray *byteArray, u_int64 near) {
+
+        // 共享数据节点不属于任何目录，整体放入数据区域
+        if (iNode.type == INode::SHARED_TYPE) return allocate(iNode, byteArray, NEAR_END);
+
+        if (iNode.type != INode::FILE_TYPE || iNode.size < SPLIT_MIN_SIZE) return allocate(iNode, byteArray, near);
+
+        // 内容作为一个分段节点从末尾分配，目录项只保存它的位置
+        INode extent{"", iNode.size, iNode.permission, INode::EXTENT_DATA_TYPE, 0, UNDEFINED};
+
+        auto extentPos = allocate(extent, byteArray, NEAR_END);
+
+        if (extentPos == UNDEFINED) return UNDEFINED;
+
+        auto entry = iNode;
+        entry.type = INode::EXTENTS_TYPE;
+        entry.size = sizeof(u_int64);
+
+        auto list = IByteable::toBytes(extentPos);
+        auto position = allocate(entry, &list, near);
+
+        if (position == UNDEFINED) removeFileAt(extentPos);
+
+        return position;
+    }
+
+    u_int64 DiskEntity::allocateExtents(const INode &iNode, const ByteArray *byteArray) {
+
+        // 分段节点名称为空，节点头部大小固定，按空闲链表顺序估算每个空闲区域可容纳的数据量
+        INode extent{"", 0, iNode.permission, INode::EXTENT_DATA_TYPE, 0, UNDEFINED};
+        extent.withHash = !_legacy;
+        extent.compact = compactOffsets();
+
+        auto headerSize = FileNode::sizeFor(extent);
+
+        std::vector<u_int64> sizes{};
+        u_int64 remaining = iNode.size;
+
+        for (auto position = getFirstEmpty(); position != UNDEFINED && remaining > 0;) {
+            auto empty = emptyAt(position);
+
+            if (empty->emptySize >= headerSize + MIN_EXTENT_SIZE) {
+                auto size = std::min(remaining, empty->emptySize - headerSize);
+                sizes.push_back(size);
+                remaining -= size;
+            }
+
+            position = empty->nextEmpty;
+            delete empty;
+        }
+
+        if (remaining > 0) return UNDEFINED;
+
+        // 前面的空闲区域已被整段占用，首次适配依次落在估算时的区域中；数据直接从调用者的缓冲区写出
+        std::vector<u_int64> extents{};
+        ByteArray list{};
+        u_int64 offset = 0;
+
+        for (auto size: sizes) {
+            extent.size = size;
+
+            // 各段按首次适配依次占用估算时的区域，不做对齐
+            auto position = allocate(extent, nullptr, UNDEFINED, false);
+
+            if (position == UNDEFINED) {
+                removeFilesAt(extents);
+                return UNDEFINED;
+            }
+
+            if (byteArray != nullptr) {
+                _fileLinker.doWithFileO(dataPos(position), 0, [&](std::ofstream &file) {
+                    file.write(reinterpret_cast<const char *>(byteArray->data() + offset),
+                               static_cast<std::streamsize>(size));
+                });
+            }
+
+            extents.push_back(position);
+            list.append(IByteable::toBytes(position));
+            offset += size;
+        }
+
+        auto entry = iNode;
+        entry.type = INode::EXTENTS_TYPE;
+        entry.size = list.size();
+
+        auto position = allocate(entry, &list);
+
+        if (position == UNDEFINED) removeFilesAt(extents);
+
+        return position;
+    }
+
+    u_int64 DiskEntity::leadFor(u_int64 from, u_int64 size, u_int64 headerSize, u_int64 dataSize, bool atEnd,
+                                bool aligned) const {
+
+        auto minEmptySize = layout().minEmptySize;
+
+        auto targetSize = headerSize + dataSize;
+
+        if (size < targetSize) return NO_FIT;
+
+        if (!aligned) {
+            // 剩余部分不足以构成空闲节点时整段占用，节点仍从区域开头放置
+            return atEnd && size - targetSize >= minEmptySize ? size - targetSize : 0;
+        }
+
+        // 节点之前留出的部分需要能构成空闲节点，否则继续后移一个对齐单位
+        if (atEnd) {
+            auto data = (from + size - dataSize) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+
+            for (; data >= from + headerSize; data -= DATA_ALIGNMENT) {
+                auto lead = data - headerSize - from;
+                if (lead == 0 || lead >= minEmptySize) return lead;
+                if (data < DATA_ALIGNMENT) break;
+            }
+
+            return NO_FIT;
+        }
+
+        auto lead = (DATA_ALIGNMENT - (from + headerSize) % DATA_ALIGNMENT) % DATA_ALIGNMENT;
+
+        if (lead > 0 && lead < minEmptySize) lead += DATA_ALIGNMENT;
+
+        return lead + targetSize <= size ? lead : NO_FIT;
+    }
+
+    u_int64 DiskEntity::allocate(const INode &iNode, const ByteArray *byteArray, u_int64 near, bool align) {
+
+        // 数据不复制进节点，写入时紧随节点头部直接写出；未给出数据时只写入节点头部，数据区域由调用者随后填充
+        FileNode targetFile = FileNode{0, 0, iNode, 0, ByteArray()};
+
+        assert(byteArray == nullptr || byteArray->size() == iNode.size, "DiskEntity::addFile", "数据大小与 inode 不一致");
+
+        targetFile.inode.withHash = !_legacy;
+        targetFile.inode.compact = compactOffsets();
+
+        auto minEmptySize = layout().minEmptySize;
+
+        u_int64 targetSize = FileNode::sizeFor(targetFile.inode);
+
+        u_int64 headerSize = targetSize - iNode.size;
 
-        FileNode targetFile = FileNode{0, 0, iNode, 0, std::move(byteArray)};
+        // 对齐布局下，较大的文件内容从对齐的位置开始
+        bool aligned = align && alignedData() && iNode.size >= DATA_ALIGNMENT &&
+                       (iNode.type == INode::FILE_TYPE || iNode.type == INode::EXTENT_DATA_TYPE ||
+                        iNode.type == INode::SHARED_TYPE);
 
-        u_int64 lastEmptyNodeNextEmptyPosWritePos = EMPTY_START;
+        auto fits = [&](u_int64 position, const EmptyNode *empty, bool atEnd) {
+            return leadFor(position, empty->emptySize, headerSize, iNode.size, atEnd, aligned) != NO_FIT;
+        };
+
+        // 所选空闲节点的上一个空闲节点，为空时所选节点即空闲链表头
+        u_int64 lastEmptyPos = UNDEFINED;
 
         auto thisEmptyNodePos = getFirstEmpty();
 
         auto emptyNode = emptyAt(thisEmptyNodePos);
 
-        while (emptyNode != nullptr) {
+        // 节点是否放在所选空闲区域的末尾（空闲区域位于目标位置之前时，末尾离目标位置最近）
+        bool atEnd = false;
+
+        if (near != UNDEFINED) {
+            // 空闲链表按位置排列：记住目标位置之前最后一个足够大的空闲区域，遇到之后的第一个即停止，取距离较近者
+            EmptyNode *before = nullptr;
+            u_int64 beforePos = UNDEFINED;
+
+            while (emptyNode != nullptr && thisEmptyNodePos < near) {
+                auto nextEmpty = emptyNode->nextEmpty;
+
+                if (fits(thisEmptyNodePos, emptyNode, true)) {
+                    delete before;
+                    before = emptyNode;
+                    beforePos = thisEmptyNodePos;
+                } else {
+                    delete emptyNode;
+                }
 
-            if (emptyNode->emptySize >= targetFile.mainSize())
-                break;
+                thisEmptyNodePos = nextEmpty;
+                emptyNode = emptyAt(thisEmptyNodePos);
+            }
+
+            while (emptyNode != nullptr && !fits(thisEmptyNodePos, emptyNode, false)) {
+                thisEmptyNodePos = emptyNode->nextEmpty;
+                delete emptyNode;
+                emptyNode = emptyAt(thisEmptyNodePos);
+            }
+
+            auto beforeEnd = beforePos + (before == nullptr ? 0 : before->emptySize);
+
+            if (before != nullptr &&
+                (emptyNode == nullptr || (near > beforeEnd ? near - beforeEnd : 0) <= thisEmptyNodePos - near)) {
+                delete emptyNode;
+                emptyNode = before;
+                thisEmptyNodePos = beforePos;
+                atEnd = true;
+            } else {
+                delete before;
+            }
+
+            if (emptyNode != nullptr) lastEmptyPos = emptyNode->lastEmpty;
+        } else {
+            while (emptyNode != nullptr) {
 
-            lastEmptyNodeNextEmptyPosWritePos = thisEmptyNodePos + NEXT_NODE_START;
+                if (fits(thisEmptyNodePos, emptyNode, false))
+                    break;
 
-            thisEmptyNodePos = emptyNode->nextEmpty;
+                lastEmptyPos = thisEmptyNodePos;
 
-            emptyNode = emptyAt(thisEmptyNodePos);
+                thisEmptyNodePos = emptyNode->nextEmpty;
+
+                emptyNode = emptyAt(thisEmptyNodePos);
+            }
         }
 
         if (emptyNode == nullptr)
             return UNDEFINED;
 
-        u_int64 emptySize = emptyNode->emptySize - targetFile.mainSize();
+        auto lead = leadFor(thisEmptyNodePos, emptyNode->emptySize, headerSize, iNode.size, atEnd, aligned);
+
+        u_int64 emptySize = emptyNode->emptySize - lead - targetSize;
+
+        if (lead > 0) {
+            // 空闲节点留在原位置，缩小为节点之前的部分
+            u_int64 targetPos = thisEmptyNodePos + lead;
+            auto nextNode = emptyNode->nextNode;
+            auto nextEmpty = emptyNode->nextEmpty;
+
+            targetFile.lastNode = thisEmptyNodePos;
+            targetFile.nextNode = nextNode;
+
+            if (emptySize < minEmptySize) {
+                targetFile.expansionSize = emptySize;
+            } else {
+                // 节点之后剩余的部分作为新的空闲节点，插入到原空闲节点之后
+                u_int64 tailPos = targetPos + targetSize;
+                EmptyNode tail = EmptyNode{targetPos, nextNode, emptySize, thisEmptyNodePos, nextEmpty, compactOffsets()};
+
+                if (nextEmpty != UNDEFINED) {
+                    writeOffset(nextEmpty, layout().lastEmptyStart, tailPos);
+                }
+
+                _fileLinker.write(tailPos, 0, tail.toBytes());
+
+                targetFile.nextNode = tailPos;
+                nextEmpty = tailPos;
+            }
+
+            // 设置下一个节点的 上一个节点位置
+            if (nextNode != UNDEFINED) {
+                writeOffset(nextNode, layout().lastNodeStart,
+                            targetFile.nextNode == nextNode ? targetPos : targetFile.nextNode);
+            }
+
+            EmptyNode node = EmptyNode{emptyNode->lastNode, targetPos, lead, emptyNode->lastEmpty, nextEmpty,
+                                       compactOffsets()};
+
+            _fileLinker.write(thisEmptyNodePos, 0, node.toBytes());
+            writeNode(targetPos, targetFile, byteArray);
+
+            delete emptyNode;
+            return targetPos;
+        }
 
-        if (emptySize < EmptyNode::MIN_REQUIRE_SIZE) {
+        if (emptySize < minEmptySize) {
 
             // 节点结构不变
 
             targetFile.expansionSize = emptySize;
             targetFile.lastNode = emptyNode->lastNode;
             targetFile.nextNode = emptyNode->nextNode;
-            assert(targetFile.mainSize() == emptyNode->emptySize, "DiskEntity::addFile",
+            assert(FileNode::sizeFor(targetFile.inode, emptySize) == emptyNode->emptySize, "DiskEntity::addFile",
                    "扩容后文件大小不等于空容量大小");
 
             auto nextEmptyPos = emptyNode->nextEmpty;
 
+            // 设置下一个空节点的 上一个空节点位置
+            if (nextEmptyPos != UNDEFINED) {
+                writeOffset(nextEmptyPos, layout().lastEmptyStart, emptyNode->lastEmpty);
+            }
+
             if (thisEmptyNodePos == getFirstEmpty()) {
                 updateFirstEmpty(nextEmptyPos);
             }
 
-            _fileLinker.write(lastEmptyNodeNextEmptyPosWritePos, 0, IByteable::toBytes(nextEmptyPos));
-            _fileLinker.write(thisEmptyNodePos, 0, targetFile.toBytes());
+            setNextEmpty(lastEmptyPos, nextEmptyPos);
+            writeNode(thisEmptyNodePos, targetFile, byteArray);
         } else {
             EmptyNode node = EmptyNode{thisEmptyNodePos, emptyNode->nextNode, emptySize, emptyNode->lastEmpty,
-                                       emptyNode->nextEmpty};
-            u_int64 newEmptyNodePos = thisEmptyNodePos + targetFile.mainSize();
+                                       emptyNode->nextEmpty, compactOffsets()};
+            u_int64 newEmptyNodePos = thisEmptyNodePos + targetSize;
 
             // 设置下一个节点的 上一个节点位置
             auto nextNode = emptyNode->nextNode;
 
             if (nextNode != UNDEFINED) {
-                _fileLinker.write(nextNode, FileSystem::LAST_NODE_START, IByteable::toBytes(newEmptyNodePos));
+                writeOffset(nextNode, layout().lastNodeStart, newEmptyNodePos);
+            }
+
+            // 设置下一个空节点的 上一个空节点位置
+            if (emptyNode->nextEmpty != UNDEFINED) {
+                writeOffset(emptyNode->nextEmpty, layout().lastEmptyStart, newEmptyNodePos);
             }
 
             targetFile.lastNode = emptyNode->lastNode;
@@ -116,21 +396,31 @@ namespace FileSystem {
                 updateFirstEmpty(newEmptyNodePos);
             }
 
-            _fileLinker.write(lastEmptyNodeNextEmptyPosWritePos, 0, IByteable::toBytes(newEmptyNodePos));
+            setNextEmpty(lastEmptyPos, newEmptyNodePos);
             _fileLinker.write(newEmptyNodePos, 0, node.toBytes());
-            _fileLinker.write(thisEmptyNodePos, 0, targetFile.toBytes());
+            writeNode(thisEmptyNodePos, targetFile, byteArray);
         }
 
         return thisEmptyNodePos;
     }
 
+    void DiskEntity::writeNode(u_int64 position, FileNode &node, const ByteArray *data) {
+        auto header = node.headerBytes();
+        _fileLinker.doWithFileO(position, 0, [&](std::ofstream &file) {
+            file.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+            if (data != nullptr) {
+                file.write(reinterpret_cast<const char *>(data->data()), static_cast<std::streamsize>(data->size()));
+            }
+        });
+    }
+
     EmptyNode *DiskEntity::emptyAt(u_int64 position) {
         if (position == UNDEFINED) return nullptr;
 
         EmptyNode *node;
 
         _fileLinker.doWithFileI(position, 0, [&](std::ifstream &it) {
-            node = EmptyNode::parse(it);
+            node = EmptyNode::parse(it, compactOffsets());
         });
 
         return node;
@@ -139,16 +429,36 @@ namespace FileSystem {
     FileNode *DiskEntity::fileAt(u_int64 position) {
         if (position == UNDEFINED) return nullptr;
         FileNode *node = nullptr;
-        _fileLinker.doWithFileI(position, 0, [&node](auto &it) { node = FileNode::parse(it); });
+        _fileLinker.doWithFileI(position, 0, [&](auto &it) { node = FileNode::parse(it, !_legacy, true, compactOffsets()); });
+        return node;
+    }
+
+    FileNode *DiskEntity::fileHeaderAt(u_int64 position) {
+        if (position == UNDEFINED) return nullptr;
+        FileNode *node = nullptr;
+        _fileLinker.doWithFileI(position, 0, [&](auto &it) { node = FileNode::parse(it, !_legacy, false, compactOffsets()); });
         return node;
     }
 
-    void DiskEntity::removeFileAt(u_int64 position) {
+    void DiskEntity::removeFileAt(u_int64 position, bool withContent) {
 
-        FileNode *file = fileAt(position);
+        // 只需要节点头部，不读取文件数据
+        FileNode *file = fileHeaderAt(position);
         if (file == nullptr) return;
 
-        u_int64 fileSize = file->mainSize();
+        auto type = file->inode.getType();
+
+        // 分段文件的各段节点随目录项一并释放
+        if (withContent && type == INode::Extents) {
+            delete file;
+            removeFilesAt({position});
+            return;
+        }
+
+        // 克隆目录项引用的共享数据节点，释放该目录项后减少其引用计数
+        u_int64 sharedPos = withContent && type == INode::Clone ? sharedOf(position) : UNDEFINED;
+
+        u_int64 fileSize = FileNode::sizeFor(file->inode, file->expansionSize);
         u_int64 emptyPos;
         EmptyNode *empty;
 
@@ -178,14 +488,14 @@ namespace FileSystem {
             u_int64 nextEmptyNextEmptyPos = nextEmpty->nextEmpty;
 
             if (nextEmptyNextEmptyPos != UNDEFINED) {
-                _fileLinker.write(nextEmpty->nextEmpty, EmptyNode::LAST_EMPTY_START, IByteable::toBytes(emptyPos));
+                writeOffset(nextEmpty->nextEmpty, layout().lastEmptyStart, emptyPos);
             }
 
             // 设置下一个节点的 上一个节点位置
             u_int64 nextNodePos = nextEmpty->nextNode;
 
             if (nextNodePos != UNDEFINED) {
-                _fileLinker.write(nextNodePos, FileSystem::LAST_NODE_START, IByteable::toBytes(emptyPos));
+                writeOffset(nextNodePos, layout().lastNodeStart, emptyPos);
             }
 
             // 设置这个节点的 下一个节点位置
@@ -209,7 +519,7 @@ namespace FileSystem {
 
             // 设置下一个节点的 上一个节点位置
             if (nextNodePos != UNDEFINED) {
-                _fileLinker.write(nextNodePos, FileSystem::LAST_NODE_START, IByteable::toBytes(emptyPos));
+                writeOffset(nextNodePos, layout().lastNodeStart, emptyPos);
             }
 
             // 设置这个空节点的 下一个节点位置
@@ -232,17 +542,17 @@ namespace FileSystem {
 
             // 设置下一个空节点的 上一个空节点位置
             if (nextEmptyPos != UNDEFINED) {
-                _fileLinker.write(nextEmptyPos, EmptyNode::LAST_EMPTY_START, IByteable::toBytes(emptyPos));
+                writeOffset(nextEmptyPos, layout().lastEmptyStart, emptyPos);
             }
 
             // 设置下一个节点的 上一个节点位置
             if (nextNodePos != UNDEFINED) {
-                _fileLinker.write(nextEmptyPos, FileSystem::LAST_NODE_START, IByteable::toBytes(emptyPos));
+                writeOffset(nextNodePos, layout().lastNodeStart, emptyPos);
             }
 
             // 设置上一个空节点的 下一个空节点位置
             if (lastEmptyPos != UNDEFINED) {
-                _fileLinker.write(lastEmptyPos, EmptyNode::NEXT_EMPTY_START, IByteable::toBytes(emptyPos));
+                writeOffset(lastEmptyPos, layout().nextEmptyStart, emptyPos);
             }
 
             // 设置这个空节点的 上一个节点位置
@@ -275,16 +585,16 @@ namespace FileSystem {
 
             // 设置上一个空节点的 下一个空节点位置
             if (lastEmptyPos != UNDEFINED) {
-                _fileLinker.write(lastEmptyPos, EmptyNode::NEXT_EMPTY_START, IByteable::toBytes(emptyPos));
+                writeOffset(lastEmptyPos, layout().nextEmptyStart, emptyPos);
             }
 
             // 设置下一个空节点的 上一个空节点位置
             if (nextEmptyPos != UNDEFINED) {
-                _fileLinker.write(nextEmptyPos, EmptyNode::LAST_EMPTY_START, IByteable::toBytes(emptyPos));
+                writeOffset(nextEmptyPos, layout().lastEmptyStart, emptyPos);
             }
 
             // 配置该空节点
-            empty = new EmptyNode(file->lastNode, file->nextNode, fileSize, lastEmptyPos, nextEmptyPos);
+            empty = new EmptyNode(file->lastNode, file->nextNode, fileSize, lastEmptyPos, nextEmptyPos, compactOffsets());
 
             if (flag) {
                 assert(nextEmptyPos == getFirstEmpty());
@@ -293,6 +603,137 @@ namespace FileSystem {
 
             _fileLinker.write(emptyPos, 0, empty->toBytes());
         }
+
+        delete file;
+
+        if (sharedPos != UNDEFINED && releaseSharedAt(sharedPos, 1)) {
+            removeFileAt(sharedPos);
+        }
+    }
+
+    void DiskEntity::removeFilesAt(std::vector<u_int64> positions) {
+
+        // 按地址顺序一次性释放，相邻的文件与空闲区域合并为同一个空节点，空闲链表只遍历一次
+        std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+        if (!positions.empty() && positions.front() == UNDEFINED) positions.erase(positions.begin());
+
+        // 克隆目录项按共享数据节点汇总引用计数的减少量，计数归零的共享数据节点一并释放；分段文件的各段节点一并释放
+        std::unordered_map<u_int64, int> released{};
+        std::vector<u_int64> extents{};
+
+        for (auto position: positions) {
+            auto type = typeAt(position);
+            if (type == INode::Clone) {
+                released[sharedOf(position)]++;
+            } else if (type == INode::Extents) {
+                auto nodes = extentNodesAt(position);
+                extents.insert(extents.end(), nodes.begin(), nodes.end());
+            }
+        }
+
+        for (const auto &it: released) {
+            if (releaseSharedAt(it.first, it.second)) positions.push_back(it.first);
+        }
+
+        positions.insert(positions.end(), extents.begin(), extents.end());
+
+        if (!released.empty() || !extents.empty()) {
+            std::sort(positions.begin(), positions.end());
+        }
+
+        u_int64 lastEmptyPos = UNDEFINED;
+        u_int64 nextEmptyPos = getFirstEmpty();
+
+        std::size_t index = 0;
+
+        while (index < positions.size()) {
+
+            u_int64 regionStart = positions[index];
+
+            // 空闲链表按地址有序，前进到当前区域之前的最后一个空节点
+            while (nextEmptyPos != UNDEFINED && nextEmptyPos < regionStart) {
+                lastEmptyPos = nextEmptyPos;
+                nextEmptyPos = readOffset(nextEmptyPos, layout().nextEmptyStart);
+            }
+
+            auto typeStr = _fileLinker.read(regionStart, 0, 4);
+            assert(FileSystem::File == FileSystem::getType(typeStr), "DiskEntity::removeFilesAt", "目标位置不是文件");
+
+            u_int64 regionLastNode = readOffset(regionStart, layout().lastNodeStart);
+            u_int64 regionLastEmpty = lastEmptyPos;
+
+            // 与前一个空节点相邻，则从该空节点开始合并
+            if (lastEmptyPos != UNDEFINED && regionLastNode == lastEmptyPos) {
+                regionStart = lastEmptyPos;
+                regionLastNode = readOffset(lastEmptyPos, layout().lastNodeStart);
+                regionLastEmpty = readOffset(lastEmptyPos, layout().lastEmptyStart);
+            }
+
+            // 向后吞并连续的待删除文件及空节点
+            u_int64 nodePos = positions[index];
+
+            while (nodePos != UNDEFINED) {
+                if (index < positions.size() && nodePos == positions[index]) {
+                    index++;
+                } else if (nodePos == nextEmptyPos) {
+                    nextEmptyPos = readOffset(nodePos, layout().nextEmptyStart);
+                } else {
+                    break;
+                }
+                nodePos = readOffset(nodePos, layout().nextNodeStart);
+            }
+
+            // 节点在物理上首尾相接，最后一个节点延伸到磁盘末尾
+            u_int64 regionEnd = nodePos != UNDEFINED ? nodePos : _fileLinker.readAt<u_int64>(0, DISK_SIZE_START);
+
+            EmptyNode empty{regionLastNode, nodePos, regionEnd - regionStart, regionLastEmpty, nextEmptyPos,
+                            compactOffsets()};
+
+            // 设置下一个节点的 上一个节点位置
+            if (nodePos != UNDEFINED) {
+                writeOffset(nodePos, layout().lastNodeStart, regionStart);
+            }
+
+            // 设置上一个空节点的 下一个空节点位置
+            if (regionLastEmpty != UNDEFINED) {
+                writeOffset(regionLastEmpty, layout().nextEmptyStart, regionStart);
+            } else {
+                updateFirstEmpty(regionStart);
+            }
+
+            // 设置下一个空节点的 上一个空节点位置
+            if (nextEmptyPos != UNDEFINED) {
+                writeOffset(nextEmptyPos, layout().lastEmptyStart, regionStart);
+            }
+
+            _fileLinker.write(regionStart, 0, empty.toBytes());
+
+            lastEmptyPos = regionStart;
+        }
+    }
+
+    u_int64 DiskEntity::nodeSizeAt(u_int64 position) {
+        // 节点在物理上首尾相接，最后一个节点延伸到磁盘末尾
+        auto nextNode = readOffset(position, layout().nextNodeStart);
+        if (nextNode == UNDEFINED) nextNode = _fileLinker.readAt<u_int64>(0, DISK_SIZE_START);
+        return nextNode - position;
+    }
+
+    u_int64 DiskEntity::capacityAt(u_int64 position) {
+        // 数据区域与扩容区域的总大小
+        return position + nodeSizeAt(position) - dataPos(position);
+    }
+
+    void DiskEntity::resizeAt(u_int64 position, u_int64 size) {
+        auto capacity = capacityAt(position);
+
+        assert(size <= capacity, "DiskEntity::resizeAt", "新的文件大小超出节点容量");
+
+        // 节点大小不变，数据区域与扩容区域之间的边界随文件大小移动
+        writeOffset(inodeFieldPos(position, layout().sizeOffset), 0, size);
+        writeOffset(dataPos(position) - layout().expansionOcc, 0, capacity - size);
     }
 
     u_int64 DiskEntity::root() {
@@ -311,7 +752,7 @@ namespace FileSystem {
 
             if (!flag) break;
 
-            res = _fileLinker.readAt<u_int64>(res, FileSystem::LAST_NODE_START);
+            res = readOffset(res, layout().lastNodeStart);
         }
 
         return res;
@@ -328,7 +769,7 @@ namespace FileSystem {
 
             if (!flag) break;
 
-            res = _fileLinker.readAt<u_int64>(res, FileSystem::NEXT_NODE_START);
+            res = readOffset(res, layout().nextNodeStart);
         }
 
         return res;
@@ -337,8 +778,8 @@ namespace FileSystem {
     INode DiskEntity::fileINodeAt(u_int64 position) {
         INode *iNode;
 
-        _fileLinker.doWithFileI(position, FileNode::INODE_START, [&](std::ifstream &it) {
-            iNode = INode::parse(it);
+        _fileLinker.doWithFileI(position, layout().inodeStart, [&](std::ifstream &it) {
+            iNode = INode::parse(it, !_legacy, compactOffsets());
         });
 
         return *iNode;
@@ -359,16 +800,259 @@ namespace FileSystem {
             sizeGood = stateSize == fileSize;
         });
 
-        assert(prefix == "SakulinF", "DiskEntity::checkFormat", "系统声明错误：" + prefix);
+        assert(prefix == "SakulinX" || prefix == "SakulinF", "DiskEntity::checkFormat", "系统声明错误：" + prefix);
+
+        _legacy = prefix == "SakulinF";
+
+        if (_legacy) {
+            _features = 0;
+            _packThreshold = 0;
+            _fileIndexStart = LEGACY_FILE_INDEX_START;
+        } else {
+            _features = _fileLinker.readAt<u_int64>(0, FEATURES_START);
+            _packThreshold = _fileLinker.readAt<u_int64>(0, PACK_THRESHOLD_START);
+            _fileIndexStart = FILE_INDEX_START;
+        }
 
         assert(sizeGood, "DiskEntity::checkFormat",
                "大小不相等：文件系统声明 " + std::to_string(stateSize) + " 与 实际大小 " + std::to_string(fileSize));
+
+        // 持有写租约的会话已经不存在，上次记录到磁盘的租约全部过期
+        if (!_legacy && _fileLinker.readAt<u_int64>(0, PERSISTED_LEASES_START) != 0) {
+            expireLeases();
+        }
+    }
+
+    void DiskEntity::expireLeases() {
+        for (auto position = _fileIndexStart; position != UNDEFINED;
+             position = readOffset(position, layout().nextNodeStart)) {
+
+            NodeType nodeType;
+            _fileLinker.doWithFileI(position, 0, [&](auto &it) { nodeType = getType(it); });
+
+            if (nodeType != NodeType::File) continue;
+
+            auto type = typeAt(position);
+
+            if (type != INode::UserFile && type != INode::Clone && type != INode::Extents) continue;
+
+            auto counterPos = inodeFieldPos(position, layout().openCounterOffset);
+
+            if (_fileLinker.readAt<int>(counterPos, 0) != 0) {
+                _fileLinker.write(counterPos, 0, IByteable::toBytes(0));
+            }
+        }
+
+        _fileLinker.write(0, PERSISTED_LEASES_START, IByteable::toBytes(u_int64{0}));
     }
 
     std::string DiskEntity::getPath() const {
         return _fileLinker.path;
     }
 
+    u_int64 DiskEntity::diskSize() const {
+        return _fileLinker.size();
+    }
+
+    bool DiskEntity::isLegacy() const {
+        return _legacy;
+    }
+
+    u_int64 DiskEntity::features() const {
+        return _features;
+    }
+
+    bool DiskEntity::splitMetadata() const {
+        return (_features & FEATURE_SPLIT_METADATA) != 0;
+    }
+
+    bool DiskEntity::alignedData() const {
+        return (_features & FEATURE_ALIGNED_DATA) != 0;
+    }
+
+    bool DiskEntity::compactOffsets() const {
+        return (_features & FEATURE_COMPACT_OFFSETS) != 0;
+    }
+
+    const NodeLayout &DiskEntity::layout() const {
+        return NodeLayout::of(compactOffsets());
+    }
+
+    u_int64 DiskEntity::nodeSizeFor(INode iNode) const {
+        iNode.withHash = !_legacy;
+        iNode.compact = compactOffsets();
+        return FileNode::sizeFor(iNode);
+    }
+
+    void DiskEntity::setAlignedData(bool aligned) {
+        assert(!_legacy, "DiskEntity::setAlignedData", "旧格式镜像没有扩展头，请先使用 upgrade 升级");
+        setFeatures(aligned ? _features | FEATURE_ALIGNED_DATA : _features & ~FEATURE_ALIGNED_DATA);
+    }
+
+    bool DiskEntity::directIO() const {
+        return _fileLinker.direct();
+    }
+
+    void DiskEntity::setDirectIO(bool direct) {
+        _fileLinker.setDirect(direct);
+    }
+
+    void DiskEntity::setFeatures(u_int64 features) {
+        _fileLinker.write(0, FEATURES_START, IByteable::toBytes(features));
+        _features = features;
+    }
+
+    u_int64 DiskEntity::packThreshold() const {
+        return _packThreshold;
+    }
+
+    void DiskEntity::setPackThreshold(u_int64 threshold) {
+        assert(!_legacy, "DiskEntity::setPackThreshold", "旧格式镜像没有扩展头，请先使用 upgrade 升级");
+        _fileLinker.write(0, PACK_THRESHOLD_START, IByteable::toBytes(threshold));
+        _packThreshold = threshold;
+    }
+
+    bool DiskEntity::matchNameAt(u_int64 position, const std::string &name, unsigned int nameHash, u_int64 &next,
+                                 bool *pack) {
+
+        // 一次读取足以包含最长名称与全部定长字段的 inode 前缀，名称与下一个同级文件地址都无需再次读取；
+        // 每次读取的开销主要在打开与定位文件，多读取的字节几乎没有代价
+        auto &layout = this->layout();
+        const u_int64 window = 1 + INode::HASH_SIZE + 0xff + layout.fixedSize;
+
+        auto head = _fileLinker.read(position, layout.inodeStart, window);
+
+        auto nameSize = static_cast<unsigned char>(head.data()[0]);
+        u_int64 nameStart = _legacy ? 1 : 1 + INode::HASH_SIZE;
+        u_int64 nextStart = nameStart + nameSize + layout.nextOffset;
+
+        next = layout.offsetFrom(head.subByte(nextStart, nextStart + layout.offsetSize));
+
+        if (pack != nullptr) *pack = nameSize == 0;
+
+        // 先比较名称长度与哈希，均一致时才比较完整名称
+        if (nameSize != name.size()) return false;
+
+        if (!_legacy && IByteable::fromBytes<unsigned int>(head.subByte(1, 1 + INode::HASH_SIZE)) != nameHash) {
+            return false;
+        }
+
+        return std::memcmp(head.data() + nameStart, name.data(), nameSize) == 0;
+    }
+
+    void DiskEntity::upgrade() {
+
+        assert(_legacy, "DiskEntity::upgrade", "镜像已是最新格式");
+
+        rebuild(DEFAULT_FEATURES);
+    }
+
+    void DiskEntity::migrate(bool split) {
+
+        assert(!_legacy, "DiskEntity::migrate", "旧格式镜像没有扩展头，请先使用 upgrade 升级");
+        assert(split != splitMetadata(), "DiskEntity::migrate", "镜像已是该布局");
+
+        rebuild(split ? _features | FEATURE_SPLIT_METADATA : _features & ~FEATURE_SPLIT_METADATA);
+    }
+
+    void DiskEntity::rebuild(u_int64 features) {
+
+        auto tempPath = _fileLinker.path + ".rebuild";
+
+        // 特性标志在创建时写入，新节点按目标的格式与布局分配
+        DiskEntity target{_fileLinker.size(), tempPath, "", features};
+
+        // 保留超级用户密码与打包阈值
+        target._fileLinker.write(0, SUPERUSER_PASSWORD_START, _fileLinker.read(0, SUPERUSER_PASSWORD_START, 32));
+        target.setPackThreshold(_packThreshold);
+
+        try {
+            std::unordered_map<u_int64, u_int64> sharedMap{};
+            target.setRoot(copyChainTo(target, root(), sharedMap).first);
+        } catch (Error &) {
+            std::filesystem::remove(tempPath);
+            throw;
+        }
+
+        std::filesystem::rename(tempPath, _fileLinker.path);
+
+        checkFormat();
+    }
+
+    std::pair<u_int64, u_int64> DiskEntity::copyChainTo(DiskEntity &target, u_int64 headPos,
+                                                        std::unordered_map<u_int64, u_int64> &sharedMap) {
+
+        u_int64 newHead = UNDEFINED;
+        u_int64 newTail = UNDEFINED;
+
+        // 只读取 inode 与少量位置信息，文件内容在两个镜像之间分块搬运，不整体读入内存
+        while (headPos != UNDEFINED) {
+
+            auto inode = fileINodeAt(headPos);
+            auto next = inode.next;
+
+            inode.next = UNDEFINED;
+            inode.openCounter = 0;
+
+            u_int64 newPos;
+
+            if (inode.getType() == INode::Folder) {
+                // 先复制子项目，文件夹索引留空，首次访问时重建
+                auto children = copyChainTo(target, folderHeadAt(headPos), sharedMap);
+                auto data = IByteable::toBytes(children.first)
+                        .append(IByteable::toBytes(children.second))
+                        .append(ByteArray(std::vector<std::byte>(BloomFilter::SLOT_SIZE).data(), BloomFilter::SLOT_SIZE));
+                inode.size = FOLDER_DATA_SIZE;
+                newPos = target.addFile(inode, data);
+            } else if (inode.getType() == INode::Clone) {
+                // 共享数据节点只复制一次，引用计数保持不变
+                auto sharedPos = sharedOf(headPos);
+                auto iter = sharedMap.find(sharedPos);
+
+                if (iter == sharedMap.end()) {
+                    auto newShared = copyContentTo(target, sharedPos, fileINodeAt(sharedPos));
+                    iter = sharedMap.emplace(sharedPos, newShared).first;
+                }
+
+                newPos = target.addFile(inode, IByteable::toBytes(iter->second));
+            } else {
+                // 分段文件的各段作为一个普通文件重新分配，由目标镜像的布局决定是否分段
+                if (inode.getType() == INode::Extents) {
+                    inode.type = INode::FILE_TYPE;
+                    inode.size = extentsSize(contentExtents(headPos));
+                }
+
+                newPos = copyContentTo(target, headPos, inode);
+            }
+
+            assert(newPos != UNDEFINED, "DiskEntity::rebuild", "重建镜像失败：磁盘空间不足");
+
+            if (newTail == UNDEFINED) {
+                newHead = newPos;
+            } else {
+                target.updateNextAt(newTail, newPos);
+            }
+
+            newTail = newPos;
+            headPos = next;
+        }
+
+        return {newHead, newTail};
+    }
+
+    u_int64 DiskEntity::copyContentTo(DiskEntity &target, u_int64 position, const INode &iNode) {
+
+        auto newPos = target.reserveFile(iNode, UNDEFINED);
+
+        assert(newPos != UNDEFINED, "DiskEntity::rebuild", "重建镜像失败：磁盘空间不足");
+
+        pairExtents(contentExtents(position), target.contentExtents(newPos), [&](u_int64 from, u_int64 to, u_int64 n) {
+            _fileLinker.copyTo(target._fileLinker, from, to, n);
+        });
+
+        return newPos;
+    }
+
     void DiskEntity::setRoot(u_int64 pos) {
         _fileLinker.write(0, DiskEntity::ROOT_START, IByteable::toBytes(pos));
     }
@@ -389,11 +1073,365 @@ namespace FileSystem {
     }
 
     void DiskEntity::updateNextAt(u_int64 originLoc, u_int64 newNext) {
-        auto it = fileINodeAt(originLoc);
+        writeOffset(inodeFieldPos(originLoc, layout().nextOffset), 0, newNext);
+    }
+
+    void DiskEntity::updatePermissionAt(u_int64 position, INode::PermissionGroup permission) {
+        _fileLinker.write(inodeFieldPos(position, layout().permissionOffset), 0, ByteArray(permission.toByte()));
+    }
+
+    void DiskEntity::recordLeaseAt(u_int64 position, bool held) {
+        assert(!_legacy, "DiskEntity::recordLeaseAt", "旧格式镜像没有扩展头，请先使用 upgrade 升级");
+
+        auto counterPos = inodeFieldPos(position, layout().openCounterOffset);
 
-        it.next = newNext;
+        if ((_fileLinker.readAt<int>(counterPos, 0) != 0) == held) return;
+
+        _fileLinker.write(counterPos, 0, IByteable::toBytes(held ? 1 : 0));
+
+        // 记录数只用于挂载时判断是否需要扫描，节点连同租约被删除时可能偏大，多扫描一次并无影响
+        auto recorded = _fileLinker.readAt<u_int64>(0, PERSISTED_LEASES_START);
+        if (!held && recorded == 0) return;
+        _fileLinker.write(0, PERSISTED_LEASES_START, IByteable::toBytes(held ? recorded + 1 : recorded - 1));
+    }
+
+    void DiskEntity::updateFolderHeadAt(u_int64 position, u_int64 head) {
+        _fileLinker.write(dataPos(position), 0, IByteable::toBytes(head));
+    }
+
+    u_int64 DiskEntity::folderHeadAt(u_int64 position) {
+        return _fileLinker.readAt<u_int64>(dataPos(position), 0);
+    }
+
+    void DiskEntity::copyRange(u_int64 from, u_int64 to, u_int64 size) const {
+        _fileLinker.copy(from, to, size);
+    }
+
+    ByteArray DiskEntity::readRange(u_int64 from, u_int64 size) {
+        return _fileLinker.read(from, 0, size);
+    }
+
+    void DiskEntity::writeRange(u_int64 from, const ByteArray &bytes) {
+        _fileLinker.write(from, 0, bytes);
+    }
 
-        _fileLinker.write(originLoc, FileNode::INODE_START, it.toBytes());
+    INode::Type DiskEntity::typeAt(u_int64 position) {
+        INode inode;
+        inode.type = std::byte{_fileLinker.readAt<unsigned char>(inodeFieldPos(position, layout().typeOffset), 0)};
+        return inode.getType();
+    }
+
+    u_int64 DiskEntity::sharedOf(u_int64 position) {
+        return _fileLinker.readAt<u_int64>(dataPos(position), 0);
+    }
+
+    void DiskEntity::shareFileAt(u_int64 position) {
+        // 普通文件原地转为共享数据节点，数据不移动：类型、引用计数（打开计数器）与下一个同级文件地址相邻，一次写入
+        _fileLinker.write(inodeFieldPos(position, layout().typeOffset), 0, ByteArray(INode::SHARED_TYPE)
+                .append(IByteable::toBytes(1))
+                .append(layout().offsetBytes(UNDEFINED)));
+    }
+
+    void DiskEntity::extentFileAt(u_int64 position) {
+        // 普通文件原地转为分段节点，数据不移动：类型、打开计数器与下一个同级文件地址相邻，一次写入
+        _fileLinker.write(inodeFieldPos(position, layout().typeOffset), 0, ByteArray(INode::EXTENT_DATA_TYPE)
+                .append(IByteable::toBytes(0))
+                .append(layout().offsetBytes(UNDEFINED)));
+    }
+
+    void DiskEntity::retainSharedAt(u_int64 sharedPos) {
+        auto counterPos = inodeFieldPos(sharedPos, layout().openCounterOffset);
+        _fileLinker.write(counterPos, 0, IByteable::toBytes(_fileLinker.readAt<int>(counterPos, 0) + 1));
+    }
+
+    bool DiskEntity::releaseSharedAt(u_int64 sharedPos, int count) {
+        auto counterPos = inodeFieldPos(sharedPos, layout().openCounterOffset);
+        auto refCount = _fileLinker.readAt<int>(counterPos, 0) - count;
+
+        if (refCount <= 0) return true;
+
+        _fileLinker.write(counterPos, 0, IByteable::toBytes(refCount));
+        return false;
+    }
+
+    FileNode *DiskEntity::contentAt(u_int64 position) {
+        auto node = fileAt(position);
+        if (node == nullptr) return node;
+
+        auto type = node->inode.getType();
+
+        if (type == INode::Clone) {
+            // 克隆文件的内容保存在共享数据节点中
+            auto shared = fileAt(IByteable::fromBytes<u_int64>(node->data));
+            node->inode.size = shared->inode.size;
+            node->data = std::move(shared->data);
+            delete shared;
+        } else if (type == INode::Extents) {
+            // 分段文件按顺序拼接各段内容
+            auto extents = contentExtents(position);
+            node->inode.size = extentsSize(extents);
+            node->data = readExtents(extents, 0, node->inode.size);
+        }
+
+        return node;
+    }
+
+    std::vector<u_int64> DiskEntity::extentNodesAt(u_int64 position) {
+        auto size = readOffset(inodeFieldPos(position, layout().sizeOffset), 0);
+        auto list = _fileLinker.read(dataPos(position), 0, size);
+
+        std::vector<u_int64> res(size / sizeof(u_int64));
+        std::memcpy(res.data(), list.data(), res.size() * sizeof(u_int64));
+        return res;
+    }
+
+    std::vector<Extent> DiskEntity::contentExtents(u_int64 position) {
+
+        // 一次读取 inode 的定长字段，得到文件大小与类型
+        auto &layout = this->layout();
+        auto fieldsPos = inodeFieldPos(position, 0);
+        auto fields = _fileLinker.read(fieldsPos, 0, layout.fixedSize);
+
+        INode inode;
+        inode.size = layout.offsetFrom(fields);
+        inode.type = fields.data()[layout.typeOffset];
+
+        auto dataStart = fieldsPos + layout.fixedSize + layout.expansionOcc;
+
+        if (inode.getType() == INode::Clone) {
+            return contentExtents(_fileLinker.readAt<u_int64>(dataStart, 0));
+        }
+
+        if (inode.getType() != INode::Extents) return {{dataStart, inode.size}};
+
+        std::vector<Extent> res{};
+
+        for (auto extentPos: extentNodesAt(position)) {
+            auto extentFieldsPos = inodeFieldPos(extentPos, 0);
+            res.push_back({extentFieldsPos + layout.fixedSize + layout.expansionOcc,
+                           readOffset(extentFieldsPos, layout.sizeOffset)});
+        }
+
+        return res;
+    }
+
+    u_int64 DiskEntity::extentsSize(const std::vector<Extent> &extents) {
+        u_int64 res = 0;
+        for (const auto &it: extents) res += it.size;
+        return res;
+    }
+
+    void DiskEntity::sliceExtents(const std::vector<Extent> &extents, u_int64 offset, u_int64 size,
+                                  const std::function<bool(u_int64, u_int64, u_int64)> &f) {
+
+        // 将文件内容中的 [offset, offset + size) 换算为各段中的镜像范围，done 为之前各段已处理的字节数
+        u_int64 done = 0;
+
+        for (const auto &it: extents) {
+            if (done == size) return;
+
+            if (offset >= it.size) {
+                offset -= it.size;
+                continue;
+            }
+
+            auto n = std::min(it.size - offset, size - done);
+            if (!f(it.from + offset, n, done)) return;
+
+            done += n;
+            offset = 0;
+        }
+
+        assert(done == size, "DiskEntity::sliceExtents", "读写范围超出文件大小");
+    }
+
+    ByteArray DiskEntity::readExtents(const std::vector<Extent> &extents, u_int64 offset, u_int64 size) {
+        ByteArray res{};
+        sliceExtents(extents, offset, size, [&](u_int64 from, u_int64 n, u_int64) {
+            _fileLinker.doWithFileI(from, 0, [&](std::ifstream &it) { res.read(it, n, false); });
+            return true;
+        });
+        return res;
+    }
+
+    void DiskEntity::writeExtents(const std::vector<Extent> &extents, u_int64 offset, const ByteArray &bytes) {
+        sliceExtents(extents, offset, bytes.size(), [&](u_int64 to, u_int64 n, u_int64 done) {
+            _fileLinker.doWithFileO(to, 0, [&](std::ofstream &it) {
+                it.write(reinterpret_cast<const char *>(bytes.data() + done), static_cast<std::streamsize>(n));
+            });
+            return true;
+        });
+    }
+
+    void DiskEntity::importExtents(const std::string &hostPath, const std::vector<Extent> &extents) const {
+        sliceExtents(extents, 0, extentsSize(extents), [&](u_int64 to, u_int64 n, u_int64 done) {
+            _fileLinker.importFrom(hostPath, to, n, done);
+            return true;
+        });
+    }
+
+    void DiskEntity::exportExtents(const std::vector<Extent> &extents, const std::string &hostPath) const {
+        // 至少写出一次，空文件也会创建（并截断）外部文件
+        if (extentsSize(extents) == 0) {
+            _fileLinker.exportTo(0, 0, hostPath);
+            return;
+        }
+
+        sliceExtents(extents, 0, extentsSize(extents), [&](u_int64 from, u_int64 n, u_int64 done) {
+            _fileLinker.exportTo(from, n, hostPath, done);
+            return true;
+        });
+    }
+
+    void DiskEntity::streamExtents(const std::vector<Extent> &extents, u_int64 offset, u_int64 size,
+                                   const std::function<bool(const char *, u_int64)> &f) const {
+        bool stopped = false;
+        sliceExtents(extents, offset, size, [&](u_int64 from, u_int64 n, u_int64) {
+            _fileLinker.stream(from, n, [&](const char *data, u_int64 length) {
+                stopped = !f(data, length);
+                return !stopped;
+            });
+            return !stopped;
+        });
+    }
+
+    void DiskEntity::pairExtents(const std::vector<Extent> &src, const std::vector<Extent> &dst,
+                                 const std::function<void(u_int64, u_int64, u_int64)> &f) {
+        std::size_t i = 0, j = 0;
+        u_int64 srcOffset = 0, dstOffset = 0;
+
+        while (i < src.size() && j < dst.size()) {
+            auto n = std::min(src[i].size - srcOffset, dst[j].size - dstOffset);
+
+            if (n > 0) f(src[i].from + srcOffset, dst[j].from + dstOffset, n);
+
+            srcOffset += n;
+            dstOffset += n;
+
+            if (srcOffset == src[i].size) i++, srcOffset = 0;
+            if (dstOffset == dst[j].size) j++, dstOffset = 0;
+        }
+    }
+
+    std::vector<PackedFile> DiskEntity::packedAt(u_int64 packPos) {
+
+        // 打包节点较小，一次读入全部记录
+        auto start = dataPos(packPos);
+        auto size = readOffset(inodeFieldPos(packPos, layout().sizeOffset), 0);
+        auto records = _fileLinker.read(start, 0, size);
+        auto bytes = records.data();
+
+        std::vector<PackedFile> res{};
+
+        for (u_int64 offset = 0; offset < size;) {
+            auto nameSize = static_cast<unsigned char>(bytes[offset]);
+
+            INode inode{
+                    std::string{reinterpret_cast<const char *>(bytes + offset + 1), nameSize},
+                    0,
+                    INode::PermissionGroup::fromByte(bytes[offset + 1 + nameSize + 8]),
+                    INode::PACKED_TYPE,
+                    0,
+                    UNDEFINED
+            };
+            std::memcpy(&inode.size, bytes + offset + 1 + nameSize, sizeof(u_int64));
+
+            res.push_back({start + offset, inode});
+            offset += PACKED_HEADER_SIZE + nameSize + inode.size;
+        }
+
+        return res;
+    }
+
+    ByteArray DiskEntity::packedRecord(const INode &iNode, const ByteArray &data) {
+        assert(iNode.name.size() <= 0xff && data.size() == iNode.size, "DiskEntity::packedRecord");
+        return ByteArray(static_cast<std::byte>((unsigned char) iNode.name.size()))
+                .append(reinterpret_cast<const std::byte *>(iNode.name.data()), iNode.name.size())
+                .append(IByteable::toBytes(iNode.size))
+                .append(iNode.permission.toByte())
+                .append(data);
+    }
+
+    u_int64 DiskEntity::packedDataPos(u_int64 position, const INode &iNode) {
+        return position + PACKED_HEADER_SIZE + iNode.name.size();
+    }
+
+    u_int64 DiskEntity::createPack(const ByteArray &records, u_int64 capacity, u_int64 next, u_int64 near) {
+
+        // 按容量预留节点，留出的空间供之后追加记录；空间不足时只按记录大小分配
+        INode pack{"", std::max(capacity, records.size()), INode::OpenPermission, INode::PACK_TYPE, 0, next};
+
+        if (pack.size == records.size()) return addFile(pack, records, near);
+
+        auto position = reserveFile(pack, near);
+
+        if (position == UNDEFINED) {
+            pack.size = records.size();
+            return addFile(pack, records, near);
+        }
+
+        _fileLinker.write(dataPos(position), 0, records);
+        resizeAt(position, records.size());
+
+        return position;
+    }
+
+    u_int64 DiskEntity::appendPacked(u_int64 packPos, const ByteArray &record) {
+        auto size = readOffset(inodeFieldPos(packPos, layout().sizeOffset), 0);
+
+        if (size + record.size() > capacityAt(packPos)) return UNDEFINED;
+
+        auto position = dataPos(packPos) + size;
+        _fileLinker.write(position, 0, record);
+        resizeAt(packPos, size + record.size());
+
+        return position;
+    }
+
+    u_int64 DiskEntity::removePacked(u_int64 packPos, u_int64 position) {
+        auto size = readOffset(inodeFieldPos(packPos, layout().sizeOffset), 0);
+        auto end = dataPos(packPos) + size;
+
+        auto nameSize = _fileLinker.readAt<unsigned char>(position, 0);
+        auto recordEnd = position + PACKED_HEADER_SIZE + nameSize + _fileLinker.readAt<u_int64>(position, 1 + nameSize);
+
+        // 之后的记录整体前移，节点大小不变，空出的部分并入扩容区域
+        if (recordEnd < end) {
+            _fileLinker.write(position, 0, _fileLinker.read(recordEnd, 0, end - recordEnd));
+        }
+
+        size -= recordEnd - position;
+        resizeAt(packPos, size);
+
+        return size;
+    }
+
+    void DiskEntity::updatePackedPermissionAt(u_int64 position, INode::PermissionGroup permission) {
+        auto nameSize = _fileLinker.readAt<unsigned char>(position, 0);
+        _fileLinker.write(position, 1 + nameSize + 8, ByteArray(permission.toByte()));
+    }
+
+    void DiskEntity::renameAt(u_int64 position, const std::string &name) {
+        // 名称长度不变时 inode 大小不变，只需覆盖名称（与名称哈希）
+        auto nameSize = _fileLinker.readAt<unsigned char>(position, layout().inodeStart);
+        assert(nameSize == name.size(), "DiskEntity::renameAt", "名称长度不一致，无法原地重命名");
+
+        auto bytes = ByteArray();
+        if (!_legacy) bytes.append(IByteable::toBytes(INode::hashName(name)));
+        bytes.append(reinterpret_cast<const std::byte *>(name.data()), name.size());
+
+        _fileLinker.write(position, layout().inodeStart + 1, bytes);
+    }
+
+    u_int64 DiskEntity::inodeFieldPos(u_int64 position, u_int64 fieldOffset) {
+        // 只读取名称长度 1 字节，即可推算出定长字段的位置
+        auto nameSize = _fileLinker.readAt<unsigned char>(position, layout().inodeStart);
+        auto hashSize = _legacy ? 0 : INode::HASH_SIZE;
+        return position + layout().inodeStart + 1 + hashSize + nameSize + fieldOffset;
+    }
+
+    u_int64 DiskEntity::dataPos(u_int64 position) {
+        return inodeFieldPos(position, layout().fixedSize) + layout().expansionOcc;
     }
 
     void DiskEntity::updateFirstEmpty(u_int64 firstEmpty) {
@@ -404,6 +1442,35 @@ namespace FileSystem {
         return _fileLinker.readAt<u_int64>(0, DiskEntity::EMPTY_START);
     }
 
+    void DiskEntity::setNextEmpty(u_int64 emptyPos, u_int64 nextEmpty) {
+        if (emptyPos == UNDEFINED) {
+            updateFirstEmpty(nextEmpty);
+        } else {
+            writeOffset(emptyPos, layout().nextEmptyStart, nextEmpty);
+        }
+    }
+
+    u_int64 DiskEntity::readOffset(u_int64 position, u_int64 fieldOffset) {
+        return layout().offsetFrom(_fileLinker.read(position, fieldOffset, layout().offsetSize));
+    }
+
+    void DiskEntity::writeOffset(u_int64 position, u_int64 fieldOffset, u_int64 value) {
+        _fileLinker.write(position, fieldOffset, layout().offsetBytes(value));
+    }
+
+    u_int64 DiskEntity::freeSize() {
+        u_int64 res = 0;
+
+        for (auto position = getFirstEmpty(); position != UNDEFINED;) {
+            auto empty = emptyAt(position);
+            res += empty->emptySize;
+            position = empty->nextEmpty;
+            delete empty;
+        }
+
+        return res;
+    }
+
     NodePtr DiskEntity::nodeAt(u_int64 position) {
 
         auto *input = _fileLinker.getFileInput(position, 0);
@@ -430,7 +1497,7 @@ namespace FileSystem {
     std::list<NodePtr> DiskEntity::getAll() {
         std::list<NodePtr> res{};
 
-        u_int64 target = FILE_INDEX_START;
+        u_int64 target = _fileIndexStart;
 
         while (target != UNDEFINED) {
             auto node = nodeAt(target);
@@ -460,7 +1527,9 @@ namespace FileSystem {
     }
 
     void DiskEntity::format(const std::string &rootPassword) {
-        format(_fileLinker.readAt<u_int64>(0, 8), rootPassword);
+        // 格式化后保持原有的偏移格式
+        format(_fileLinker.readAt<u_int64>(0, 8), rootPassword,
+               DEFAULT_FEATURES | (_features & FEATURE_COMPACT_OFFSETS));
     }
 
 
@@ -11,23 +11,43 @@
 #include <vector>
 #include <fstream>
 #include <functional>
+#include <unordered_map>
 #include "FileNode.h"
 #include "Utils.h"
 #include "SHA256.h"
 #include "EmptyNode.h"
 #include "FileLinker.h"
+#include "BloomFilter.h"
 
 namespace FileSystem {
 
     const u_int64 MAX_BYTE_SIZE = u_int64{0xFFFFFFFFFFFFFFFF}; // 8 字节
 
-    const static u_int64 LAST_NODE_START = 4;
-    const static u_int64 NEXT_NODE_START = 12;
+    /**
+     * 文件夹数据： | 首个子项目位置 8 字节 | 末尾子项目位置 8 字节 | 名称过滤器 128 字节 |
+     * 旧格式的文件夹数据只有首个子项目位置 8 字节
+     */
+    const static u_int64 FOLDER_TAIL_OFFSET = 8;
+    const static u_int64 FOLDER_BLOOM_OFFSET = 16;
+    const static u_int64 FOLDER_DATA_SIZE = FOLDER_BLOOM_OFFSET + BloomFilter::SLOT_SIZE;
 
     /**
      * 系统最大支持空间： 2^64 Byte = 2^54 KB = 2^44 MB = 2^34 GB
-     * 存储格式： | 文件系统标识 8 字节 | 磁盘大小 8 字节 |  Root 根目录头文件地址 8 字节 | 空闲链表头地址 8 字节 | 超级用户密码 32 字节 | 文件数据 |
-     * 文件索引开始位置 64 字节
+     * 存储格式： | 文件系统标识 8 字节 | 磁盘大小 8 字节 |  Root 根目录头文件地址 8 字节 | 空闲链表头地址 8 字节 | 超级用户密码 32 字节 | 扩展头 64 字节 | 文件数据 |
+     * 扩展头： | 特性标志 8 字节 | 小文件打包阈值 8 字节 | 已记录的写租约数 8 字节 | 保留 40 字节 |
+     * 文件索引开始位置 128 字节
+     *
+     * 旧格式镜像（标识为 SakulinF）没有扩展头，文件索引开始位置为 64 字节，可使用 upgrade 升级
+     *
+     * 元数据分离布局（FEATURE_SPLIT_METADATA）：文件内容从镜像末尾向前分配为独立的分段节点，
+     * 目录项（inode 与分段位置列表）、文件夹与打包节点从镜像开头分配，集中在连续的区域中，
+     * 列目录、路径解析与遍历目录树时只需读取元数据区域
+     *
+     * 内容对齐（FEATURE_ALIGNED_DATA）：不小于 DATA_ALIGNMENT 的文件内容从 DATA_ALIGNMENT 的整数倍位置开始，
+     * 节点之前留出的部分保留为空闲节点，可供较小的节点使用
+     *
+     * 紧凑格式（FEATURE_COMPACT_OFFSETS）：只能在创建不超过 4GB 的镜像时选择，节点头部、inode 与空闲节点中的位置与大小字段为 4 字节，
+     * 字段偏移见 NodeLayout；超级块与文件数据（文件夹数据、分段位置列表、打包记录等）的格式不变
      */
 
     typedef struct {
@@ -42,16 +62,67 @@ namespace FileSystem {
 
     const u_int64 UNDEFINED = 0;
 
+    /**
+     * 文件内容在镜像中的一段连续范围，普通文件只有一段，分段文件按顺序由多段组成
+     */
+    struct Extent {
+        u_int64 from;
+        u_int64 size;
+    };
+
+    /**
+     * 打包节点的数据由多条记录依次排列而成：
+     * | 名称长度 1 字节 | 名称 n | 文件大小 8 字节 | 权限信息 1 字节 | 数据 |
+     */
+    const static u_int64 PACKED_HEADER_SIZE = 10;
+
+    /**
+     * 打包节点中的一个小文件：记录在镜像中的位置与 inode（类型为 Packed）
+     */
+    struct PackedFile {
+        u_int64 position;
+        INode inode;
+    };
+
+    // 特性标志
+    const u_int64 FEATURE_NAME_HASH = 1 << 0;
+    const u_int64 FEATURE_SPLIT_METADATA = 1 << 1;
+    const u_int64 FEATURE_ALIGNED_DATA = 1 << 2;
+    const u_int64 FEATURE_COMPACT_OFFSETS = 1 << 3;
+
+    // 新建镜像默认启用的特性
+    const u_int64 DEFAULT_FEATURES = FEATURE_NAME_HASH;
+
     class DiskEntity {
 
         const static u_int64 DISK_SIZE_START = 8;
         const static u_int64 ROOT_START = 16;
         const static u_int64 EMPTY_START = 24;
-        const static u_int64 FILE_INDEX_START = 64;
+        const static u_int64 LEGACY_FILE_INDEX_START = 64;
         const static u_int64 SUPERUSER_PASSWORD_START = 32;
+        const static u_int64 FEATURES_START = 64;
+        const static u_int64 PACK_THRESHOLD_START = 72;
+        const static u_int64 PERSISTED_LEASES_START = 80;
+        const static u_int64 FILE_INDEX_START = 128;
+        const static u_int64 NEAR_END = MAX_BYTE_SIZE;
+        const static u_int64 NO_FIT = MAX_BYTE_SIZE;
 
     public:
-        DiskEntity(u_int64 size, std::string path, const std::string &root_password);
+
+        // 分段存储时，可容纳数据少于该值的空闲区域不再使用
+        const static u_int64 MIN_EXTENT_SIZE = 64;
+
+        // 元数据分离布局下，内容不少于该值的文件才放入数据区域，更小的文件仍与 inode 存放在一起
+        const static u_int64 SPLIT_MIN_SIZE = 256;
+
+        // 内容对齐的单位，同时也是需要对齐的最小文件内容大小
+        const static u_int64 DATA_ALIGNMENT = 4096;
+
+        // 紧凑格式镜像的最大大小
+        const static u_int64 COMPACT_MAX_SIZE = u_int64{1} << 32;
+
+        DiskEntity(u_int64 size, std::string path, const std::string &root_password,
+                   u_int64 features = DEFAULT_FEATURES);
 
         explicit DiskEntity(std::string path);
 
@@ -63,42 +134,217 @@ namespace FileSystem {
 
         FileNode *fileAt(u_int64 position);
 
+        FileNode *fileHeaderAt(u_int64 position);
+
         NodePtr nodeAt(u_int64 position);
 
-        void removeFileAt(u_int64 position);
+        // withContent 为 false 时只释放目录项节点本身，共享数据与分段节点保持不变
+        void removeFileAt(u_int64 position, bool withContent = true);
+
+        void removeFilesAt(std::vector<u_int64> positions);
+
+        // near 不为空时优先使用离该位置最近的空闲区域（如所在目录或上一个同级项目的节点），使同一目录的项目聚集
+        u_int64 addFile(const INode &iNode, const ByteArray &byteArray, u_int64 near = UNDEFINED);
 
-        u_int64 addFile(const INode &iNode, ByteArray byteArray);
+        u_int64 reserveFile(const INode &iNode, u_int64 near = UNDEFINED);
 
         void updateWithoutSizeChange(u_int64 originLoc, FileNode &newFile);
 
         void updateNextAt(u_int64 originLoc, u_int64 newNext);
 
+        void updatePermissionAt(u_int64 position, INode::PermissionGroup permission);
+
+        // 在打开计数器中记录或清除写租约，并维护扩展头中已记录的租约数，挂载时据此让上次遗留的租约过期
+        void recordLeaseAt(u_int64 position, bool held);
+
+        void updateFolderHeadAt(u_int64 position, u_int64 head);
+
+        u_int64 folderHeadAt(u_int64 position);
+
+        u_int64 dataPos(u_int64 position);
+
+        u_int64 nodeSizeAt(u_int64 position);
+
+        u_int64 capacityAt(u_int64 position);
+
+        void resizeAt(u_int64 position, u_int64 size);
+
+        ByteArray readRange(u_int64 from, u_int64 size);
+
+        void writeRange(u_int64 from, const ByteArray &bytes);
+
+        void copyRange(u_int64 from, u_int64 to, u_int64 size) const;
+
         void updateFirstEmpty(u_int64 firstEmpty);
 
         u_int64 getFirstEmpty();
 
+        u_int64 freeSize();
+
         bool assertSuperUser(std::string password);
 
         std::list<NodePtr> getAll();
 
         INode fileINodeAt(u_int64 position);
 
-        void format(u_int64 diskSize, const std::string &rootPassword);
+        void format(u_int64 diskSize, const std::string &rootPassword, u_int64 features);
 
         void format(const std::string &rootPassword);
 
         std::string getPath() const;
 
+        [[nodiscard]] u_int64 diskSize() const;
+
+        [[nodiscard]] bool isLegacy() const;
+
+        [[nodiscard]] u_int64 features() const;
+
+        [[nodiscard]] bool splitMetadata() const;
+
+        [[nodiscard]] bool alignedData() const;
+
+        [[nodiscard]] bool compactOffsets() const;
+
+        [[nodiscard]] const NodeLayout &layout() const;
+
+        // 按本镜像的格式存放该 inode 及其数据时的节点大小
+        [[nodiscard]] u_int64 nodeSizeFor(INode iNode) const;
+
+        // 只影响之后分配的节点，已有的文件在镜像重建时按新设置重新分配
+        void setAlignedData(bool aligned);
+
+        // 大文件的导入、导出与分块读取是否绕过页缓存（不保存在镜像中）
+        [[nodiscard]] bool directIO() const;
+
+        void setDirectIO(bool direct);
+
+        [[nodiscard]] u_int64 packThreshold() const;
+
+        void setPackThreshold(u_int64 threshold);
+
+        // 名称为空的节点为打包节点，不会与任何名称匹配，pack 不为空时通过它告知调用者
+        bool matchNameAt(u_int64 position, const std::string &name, unsigned int nameHash, u_int64 &next,
+                         bool *pack = nullptr);
+
+        void renameAt(u_int64 position, const std::string &name);
+
+        INode::Type typeAt(u_int64 position);
+
+        u_int64 sharedOf(u_int64 position);
+
+        void shareFileAt(u_int64 position);
+
+        void extentFileAt(u_int64 position);
+
+        void retainSharedAt(u_int64 sharedPos);
+
+        bool releaseSharedAt(u_int64 sharedPos, int count);
+
+        FileNode *contentAt(u_int64 position);
+
+        std::vector<u_int64> extentNodesAt(u_int64 position);
+
+        std::vector<Extent> contentExtents(u_int64 position);
+
+        static u_int64 extentsSize(const std::vector<Extent> &extents);
+
+        ByteArray readExtents(const std::vector<Extent> &extents, u_int64 offset, u_int64 size);
+
+        void writeExtents(const std::vector<Extent> &extents, u_int64 offset, const ByteArray &bytes);
+
+        void importExtents(const std::string &hostPath, const std::vector<Extent> &extents) const;
+
+        void exportExtents(const std::vector<Extent> &extents, const std::string &hostPath) const;
+
+        void streamExtents(const std::vector<Extent> &extents, u_int64 offset, u_int64 size,
+                           const std::function<bool(const char *, u_int64)> &f) const;
+
+        /**
+         * 将源与目标两组范围按各自的分段边界切分并一一对应，用于在分段布局不同的文件之间搬运数据
+         */
+        static void pairExtents(const std::vector<Extent> &src, const std::vector<Extent> &dst,
+                                const std::function<void(u_int64 from, u_int64 to, u_int64 size)> &f);
+
+        std::vector<PackedFile> packedAt(u_int64 packPos);
+
+        static ByteArray packedRecord(const INode &iNode, const ByteArray &data);
+
+        static u_int64 packedDataPos(u_int64 position, const INode &iNode);
+
+        u_int64 createPack(const ByteArray &records, u_int64 capacity, u_int64 next, u_int64 near = UNDEFINED);
+
+        u_int64 appendPacked(u_int64 packPos, const ByteArray &record);
+
+        u_int64 removePacked(u_int64 packPos, u_int64 position);
+
+        void updatePackedPermissionAt(u_int64 position, INode::PermissionGroup permission);
+
+        void upgrade();
+
+        // 按新的布局重建镜像，已有文件全部重新分配
+        void migrate(bool split);
+
     private:
 
         void checkFormat();
 
+        // 清除上次挂载遗留在目录项打开计数器中的写租约（共享数据节点的计数器为引用计数，不受影响）
+        void expireLeases();
+
+        void rebuild(u_int64 features);
+
+        void setFeatures(u_int64 features);
+
+        // 节点放置位置：未给出 near 时首次适配；给出时取离 near 最近的空闲区域，区域在 near 之前则放在区域末尾；
+        // NEAR_END 即尽量靠近镜像末尾
+        // align 为 false 时即使启用了内容对齐也不对齐
+        u_int64 allocate(const INode &iNode, const ByteArray *byteArray, u_int64 near = UNDEFINED, bool align = true);
+
+        /**
+         * 在 from 开始、大小为 size 的空闲区域中放置节点时，节点之前需要留出的字节数，放不下时为 NO_FIT
+         */
+        u_int64 leadFor(u_int64 from, u_int64 size, u_int64 headerSize, u_int64 dataSize, bool atEnd,
+                        bool aligned) const;
+
+        u_int64 allocateExtents(const INode &iNode, const ByteArray *byteArray);
+
+        u_int64 allocateSplit(const INode &iNode, const ByteArray *byteArray, u_int64 near);
+
+        static void sliceExtents(const std::vector<Extent> &extents, u_int64 offset, u_int64 size,
+                                 const std::function<bool(u_int64 from, u_int64 size, u_int64 done)> &f);
+
+        void writeNode(u_int64 position, FileNode &node, const ByteArray *data);
+
         u_int64 findLastEmpty(u_int64 nowNode);
 
         u_int64 findNextEmpty(u_int64 nowNode);
 
+        u_int64 inodeFieldPos(u_int64 position, u_int64 fieldOffset);
+
+        // 按本镜像的字段宽度读写节点中的位置或大小字段
+        u_int64 readOffset(u_int64 position, u_int64 fieldOffset);
+
+        void writeOffset(u_int64 position, u_int64 fieldOffset, u_int64 value);
+
+        // 设置空闲节点的下一个空闲节点位置，emptyPos 为空时设置空闲链表头
+        void setNextEmpty(u_int64 emptyPos, u_int64 nextEmpty);
+
+        std::pair<u_int64, u_int64> copyChainTo(DiskEntity &target, u_int64 headPos,
+                                                std::unordered_map<u_int64, u_int64> &sharedMap);
+
+        // 在目标镜像中预留与 iNode 相同大小的节点，再将 position 处节点的内容分块搬运过去
+        u_int64 copyContentTo(DiskEntity &target, u_int64 position, const INode &iNode);
+
         FileLinker _fileLinker;
 
+        bool _legacy{false};
+
+        u_int64 _features{DEFAULT_FEATURES};
+
+        u_int64 _packThreshold{0};
+
+        u_int64 _fileIndexStart{FILE_INDEX_START};
+
     };
 
 } // FileSystem
@@ -7,33 +7,39 @@
 namespace FileSystem {
 
 
-    EmptyNode::EmptyNode(u_int64 lastNode, u_int64 nextNode, u_int64 emptySize, u_int64 lastEmpty, u_int64 nextEmpty) :
+    EmptyNode::EmptyNode(u_int64 lastNode, u_int64 nextNode, u_int64 emptySize, u_int64 lastEmpty, u_int64 nextEmpty,
+                         bool compact) :
             lastNode(lastNode),
             nextNode(nextNode),
             emptySize(emptySize),
             lastEmpty(lastEmpty),
-            nextEmpty(nextEmpty) {}
+            nextEmpty(nextEmpty),
+            compact(compact) {}
+
+    EmptyNode *EmptyNode::parse(std::istream &input, bool compact) {
+        auto &layout = NodeLayout::of(compact);
 
-    EmptyNode *EmptyNode::parse(std::istream &input) {
         ByteArray().read(input, 4, false);
 
-        auto _1 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _2 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _3 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _4 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _5 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
+        auto _1 = layout.readOffset(input);
+        auto _2 = layout.readOffset(input);
+        auto _3 = layout.readOffset(input);
+        auto _4 = layout.readOffset(input);
+        auto _5 = layout.readOffset(input);
 
-        return new EmptyNode(_1, _2, _3, _4, _5);
+        return new EmptyNode(_1, _2, _3, _4, _5, compact);
     }
 
     ByteArray EmptyNode::toBytes() {
+        auto &layout = NodeLayout::of(compact);
+
         return ByteArray()
                 .append(reinterpret_cast<const std::byte *>("EMPT"), 4)
-                .append(IByteable::toBytes(lastNode))
-                .append(IByteable::toBytes(nextNode))
-                .append(IByteable::toBytes(emptySize))
-                .append(IByteable::toBytes(lastEmpty))
-                .append(IByteable::toBytes(nextEmpty));
+                .append(layout.offsetBytes(lastNode))
+                .append(layout.offsetBytes(nextNode))
+                .append(layout.offsetBytes(emptySize))
+                .append(layout.offsetBytes(lastEmpty))
+                .append(layout.offsetBytes(nextEmpty));
     }
 
     std::string EmptyNode::toString(u_int64 pos) const {
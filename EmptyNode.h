@@ -9,6 +9,7 @@
 #include <iostream>
 
 #include "Utils.h"
+#include "NodeLayout.h"
 
 namespace FileSystem {
 
@@ -20,18 +21,17 @@ namespace FileSystem {
      * 空闲链表节点的标识本身需占用 44 字节
      * 如果空闲区域小于 44 字节，则强制扩容在其之前的文件
      *
+     * 紧凑格式的镜像中各位置与大小字段为 4 字节，节点只需 24 字节，各字段偏移见 NodeLayout
+     *
      */
 
 
     class EmptyNode : IByteable {
     public:
-        const static u_int64 LAST_EMPTY_START = 28;
-        const static u_int64 NEXT_EMPTY_START = 36;
-        const static u_int64 MIN_REQUIRE_SIZE = 44;
-
-        EmptyNode(u_int64 lastNode, u_int64 nextNode, u_int64 emptySize, u_int64 lastEmpty, u_int64 nextEmpty);
+        EmptyNode(u_int64 lastNode, u_int64 nextNode, u_int64 emptySize, u_int64 lastEmpty, u_int64 nextEmpty,
+                  bool compact = false);
 
-        static EmptyNode *parse(std::istream &input);
+        static EmptyNode *parse(std::istream &input, bool compact = false);
 
         ByteArray toBytes() override;
 
@@ -43,6 +43,8 @@ namespace FileSystem {
         u_int64 lastEmpty;
         u_int64 nextEmpty;
 
+        bool compact;
+
     };
 
 } // FileSystem
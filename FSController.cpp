@@ -5,7 +5,13 @@
 #include "FSController.h"
 #include "UserTable.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
 #include <ranges>
+#include <thread>
+#include <unordered_set>
 #include <utility>
 
 namespace FileSystem {
@@ -14,7 +20,8 @@ namespace FileSystem {
             ByteArray fileData,
             INode oldINode,
             std::list<std::string> oldPath,
-            std::function<bool(const ByteArray &, INode oldINode, std::list<std::string> oldPath)> onFinish,
+            std::function<bool(const ByteArray &, const ByteArray &oldData, INode oldINode,
+                               std::list<std::string> oldPath)> onFinish,
             std::function<void(std::list<std::string> oldPath)> onCancel) :
             _fileData{std::move(fileData)},
             _onFinish{std::move(onFinish)},
@@ -22,12 +29,12 @@ namespace FileSystem {
             _onCancel{std::move(onCancel)},
             _oldPath{std::move(oldPath)} {}
 
-    ByteArray FSController::EditSession::getFileData() {
+    const ByteArray &FSController::EditSession::getFileData() const {
         return _fileData;
     }
 
     bool FSController::EditSession::assignEditFinish(const ByteArray &newData) {
-        return _onFinish(newData, _oldINode, _oldPath);
+        return _onFinish(newData, _fileData, _oldINode, _oldPath);
     }
 
     std::string FSController::EditSession::getFileName() {
@@ -38,21 +45,44 @@ namespace FileSystem {
         _onCancel(_oldPath);
     }
 
+    FSController::~FSController() {
+        _reclaimer.shutdown();
+    }
+
     bool FSController::good() const {
         return _diskEntity != nullptr;
     }
 
-    void FSController::create(u_int64 size, std::string path, const std::string &root_password) {
-        _diskEntity = new DiskEntity{size, std::move(path), root_password};
+    std::unique_lock<std::recursive_mutex> FSController::lock() const {
+        return std::unique_lock<std::recursive_mutex>{_diskMutex};
+    }
+
+    void FSController::create(u_int64 size, std::string path, const std::string &root_password, bool compact) {
+        _reclaimer.drain();
+        _diskEntity = new DiskEntity{size, std::move(path), root_password,
+                                     compact ? DEFAULT_FEATURES | FEATURE_COMPACT_OFFSETS : DEFAULT_FEATURES};
+        _reclaimer.setDisk(_diskEntity);
+        _leases.clear();
+        _persistLeases = false;
+        _lazyDelete = false;
+        _workDir = {};
+        _folderIndex.clear();
         changeRole(INode::Admin, root_password);
         createFile(getUserMapPath(), {}, INode::AdminOnlyPermission);
     }
 
     void FSController::setPath(std::string path) {
+        _reclaimer.drain();
         _diskEntity = new DiskEntity{std::move(path)};
+        _reclaimer.setDisk(_diskEntity);
+        _leases.clear();
+        _persistLeases = false;
+        _lazyDelete = false;
+        _workDir = {};
+        _folderIndex.clear();
     }
 
-    u_int64 FSController::getFilePos(const std::list<std::string> &_filePath) const {
+    u_int64 FSController::getFilePos(const std::list<std::string> &_filePath, INode *iNode) const {
 
         auto fixedPath = fixPath(_filePath);
 
@@ -62,43 +92,171 @@ namespace FileSystem {
 
         fixedPath.pop_back();
 
-        u_int64 headPos = _diskEntity->root();
+        auto headPos = findChild(resolveFolder(fixedPath), last, iNode);
 
-        while (!fixedPath.empty()) {
+        assert(
+                headPos != UNDEFINED,
+                "FSController::getFilePos",
+                "目标项目不存在：" + last
+        );
 
-            auto part = fixedPath.front();
+        return headPos;
+    }
 
-            fixedPath.pop_front();
+    FSController::FolderRef FSController::resolveFolder(const std::list<std::string> &_folderPath) const {
 
-            while (headPos != UNDEFINED) {
-                auto inode = _diskEntity->fileINodeAt(headPos);
-                if (inode.name == part) break;
-                headPos = inode.next;
-            }
+        auto fixedPath = fixPath(_folderPath);
+
+        FolderRef folder{UNDEFINED, _diskEntity->root()};
+
+        // 目标位于工作目录之下时，直接从工作目录节点开始解析，无需遍历其所有祖先
+        if (_workDir.position != UNDEFINED
+            && fixedPath.size() >= _workDir.path.size()
+            && std::equal(_workDir.path.begin(), _workDir.path.end(), fixedPath.begin())) {
+            folder = {_workDir.position, _diskEntity->folderHeadAt(_workDir.position)};
+            fixedPath.erase(fixedPath.begin(), std::next(fixedPath.begin(), (long) _workDir.path.size()));
+        }
+
+        for (const auto &part: fixedPath) {
+
+            INode inode;
+
+            auto partPos = findChild(folder, part, &inode);
 
             assert(
-                    headPos != UNDEFINED,
-                    "FSController::getFilePos",
+                    partPos != UNDEFINED,
+                    "FSController::resolveFolder",
                     "目标路径部分不存在：" + part
             );
 
-            headPos = IByteable::fromBytes<u_int64>(_diskEntity->fileAt(headPos)->data);
+            assert(inode.getType() == INode::Folder, "FSController::resolveFolder", "目标路径部分不为文件夹：" + part);
 
+            folder = {partPos, _diskEntity->folderHeadAt(partPos)};
         }
 
-        while (headPos != UNDEFINED) {
-            auto inode = _diskEntity->fileINodeAt(headPos);
-            if (inode.name == last) break;
-            headPos = inode.next;
+        return folder;
+    }
+
+    u_int64 FSController::findChild(const FSController::FolderRef &folder, const std::string &name, INode *iNode) const {
+
+        if (!folderIndex(folder).bloom.mayContain(name)) {
+            _folderIndexStats.filtered++;
+            return UNDEFINED;
         }
 
-        assert(
-                headPos != UNDEFINED,
-                "FSController::getFilePos",
-                "目标项目不存在：" + last
+        auto nameHash = INode::hashName(name);
+
+        for (auto headPos = folder.head; headPos != UNDEFINED;) {
+            u_int64 next;
+            bool pack;
+            if (_diskEntity->matchNameAt(headPos, name, nameHash, next, &pack)) {
+                if (iNode != nullptr) *iNode = _diskEntity->fileINodeAt(headPos);
+                return headPos;
+            }
+            if (pack) {
+                auto position = findPacked(headPos, name, iNode);
+                if (position != UNDEFINED) return position;
+            }
+            headPos = next;
+        }
+
+        _folderIndexStats.falsePositives++;
+        return UNDEFINED;
+    }
+
+    u_int64 FSController::findPacked(u_int64 packPos, const std::string &name, INode *iNode) const {
+        for (auto &it: _diskEntity->packedAt(packPos)) {
+            if (it.inode.name == name) {
+                if (iNode != nullptr) *iNode = std::move(it.inode);
+                return it.position;
+            }
+        }
+        return UNDEFINED;
+    }
+
+    FSController::FolderIndex &FSController::folderIndex(const FSController::FolderRef &folder) const {
+
+        auto iter = _folderIndex.find(folder.position);
+
+        if (iter == _folderIndex.end()) {
+            FolderIndex index{UNDEFINED, BloomFilter{0}, false};
+
+            // 旧格式的文件夹数据只有 8 字节，没有持久化的索引，只能在内存中重建
+            if (folder.position != UNDEFINED &&
+                _diskEntity->fileINodeAt(folder.position).size >= FOLDER_DATA_SIZE) {
+                auto dataPos = _diskEntity->dataPos(folder.position);
+                index.persistent = true;
+                index.tail = IByteable::fromBytes<u_int64>(_diskEntity->readRange(dataPos + FOLDER_TAIL_OFFSET, 8));
+                index.bloom = BloomFilter::parse(
+                        _diskEntity->readRange(dataPos + FOLDER_BLOOM_OFFSET, BloomFilter::SLOT_SIZE));
+            }
+
+            iter = _folderIndex.emplace(folder.position, std::move(index)).first;
+        }
+
+        auto &index = iter->second;
+
+        if (index.bloom.stale()) {
+            std::list<std::string> names{};
+            index.tail = UNDEFINED;
+            for (auto headPos = folder.head; headPos != UNDEFINED;) {
+                auto inode = _diskEntity->fileINodeAt(headPos);
+                if (inode.getType() == INode::Pack) {
+                    for (const auto &it: _diskEntity->packedAt(headPos)) names.push_back(it.inode.name);
+                } else {
+                    names.push_back(inode.name);
+                }
+                index.tail = headPos;
+                headPos = inode.next;
+            }
+
+            index.bloom = BloomFilter::forEntries(names.size());
+            for (const auto &name: names) index.bloom.add(name);
+
+            // 查找路径不写镜像，由下一次修改该目录的操作一并写回
+        }
+
+        return index;
+    }
+
+    void FSController::persistFolderIndex(u_int64 folderPos, FSController::FolderIndex &index) {
+        if (!index.persistent) return;
+        _diskEntity->writeRange(
+                _diskEntity->dataPos(folderPos) + FOLDER_TAIL_OFFSET,
+                IByteable::toBytes(index.tail).append(index.bloom.toBytes())
         );
+    }
 
-        return headPos;
+    FSController::FolderIndexStats FSController::getFolderIndexStats() const {
+        auto res = _folderIndexStats;
+        res.folders = _folderIndex.size();
+        res.bloomBytes = 0;
+        for (const auto &it: _folderIndex) {
+            res.bloomBytes += it.second.bloom.byteSize();
+        }
+        return res;
+    }
+
+    FSController::DirHandle FSController::openDir(const std::list<std::string> &_folderPath) {
+
+        auto folderPath = fixPath(_folderPath);
+
+        if (folderPath.empty()) return {};
+
+        INode inode;
+        auto folderPos = getFilePos(folderPath, &inode);
+
+        assert(inode.getType() == INode::Folder, "FSController::openDir", "目标项目不是文件夹");
+
+        return {folderPath, folderPos};
+    }
+
+    void FSController::setWorkingDir(const FSController::DirHandle &dir) {
+        _workDir = dir;
+    }
+
+    const FSController::DirHandle &FSController::getWorkingDir() const {
+        return _workDir;
     }
 
     std::string FSController::getTitle() const {
@@ -119,78 +277,147 @@ namespace FileSystem {
 
         assertLogin();
 
-        auto dirFiles = getDir(fixPath(folderPath));
+        // 创建并添加新的文件夹
+        INode newFolderINode{std::move(fileName), FOLDER_DATA_SIZE, permission, INode::FOLDER_TYPE, 0, UNDEFINED};
 
-        assert(
-                !std::any_of(
-                        dirFiles.begin(),
-                        dirFiles.end(),
-                        [&fileName](const INode &it) -> bool {
-                            return it.name == fileName;
-                        }
-                ),
-                "FSController::createDir",
-                "当前目录下已存在相同文件名的项目！"
-        );
+        auto res = insertChild(folderPath, newFolderINode, emptyFolderData(), false, "FSController::createDir");
 
-        // 创建并添加新的文件夹
-        INode newFolderINode{fileName, 8, permission, INode::FOLDER_TYPE, 0, UNDEFINED};
-        auto createPos = _diskEntity->addFile(newFolderINode, IByteable::toBytes(UNDEFINED));
+        assert(res.position != UNDEFINED, "FSController::createDir", "文件夹创建失败：当前系统已没有足够空间！");
+
+        return res.position;
+    }
+
+    ByteArray FSController::emptyFolderData() {
+        return IByteable::toBytes(UNDEFINED)
+                .append(IByteable::toBytes(UNDEFINED))
+                .append(BloomFilter().toBytes());
+    }
 
-        assert(createPos != UNDEFINED, "FSController::createDir", "文件夹创建失败：当前系统已没有足够空间！");
+    u_int64 FSController::alignmentGap(u_int64 gap, u_int64 minEmptySize) {
+        // 整数个对齐单位的部分仍可被其他节点使用，属于普通的空闲空间；
+        // 对齐只要求留出不足一个单位的零头，零头不足以构成空闲节点时再多留一个单位
+        auto lead = gap % DiskEntity::DATA_ALIGNMENT;
+        if (lead != 0 && lead < minEmptySize) lead += DiskEntity::DATA_ALIGNMENT;
+        return std::min(lead, gap);
+    }
+
+    FSController::InsertResult FSController::insertChild(const std::list<std::string> &_folderPath, const INode &iNode,
+                                                         const ByteArray &data, bool openExisting,
+                                                         const std::string &func, bool packable) {
 
-        // 将新的文件夹链接到当前目录下
-        u_int64 head;
+        auto folder = resolveFolder(_folderPath);
 
-        if (folderPath.empty()) {
-            // root
-            head = _diskEntity->root();
-            if (head == UNDEFINED) {
-                // root 为空
-                _diskEntity->setRoot(createPos);
-                return createPos;
+        return insertInto(folder, iNode, &data, openExisting, func, packable);
+    }
+
+    FSController::InsertResult FSController::insertInto(FSController::FolderRef &folder, const INode &iNode,
+                                                        const ByteArray *data, bool openExisting,
+                                                        const std::string &func, bool packable) {
+
+        auto &index = folderIndex(folder);
+
+        u_int64 tailPos = index.tail;
+
+        if (index.bloom.mayContain(iNode.name)) {
+            // 单次遍历：检查同名项目，同时记住链表尾部
+            tailPos = UNDEFINED;
+
+            auto nameHash = INode::hashName(iNode.name);
+
+            for (auto headPos = folder.head; headPos != UNDEFINED;) {
+                u_int64 next;
+                bool pack;
+                auto position = _diskEntity->matchNameAt(headPos, iNode.name, nameHash, next, &pack)
+                                ? headPos : pack ? findPacked(headPos, iNode.name, nullptr) : UNDEFINED;
+                if (position != UNDEFINED) {
+                    assert(openExisting, func, "当前目录下已存在相同文件名的项目！");
+                    return {position, false};
+                }
+                tailPos = headPos;
+                headPos = next;
             }
+
+            _folderIndexStats.falsePositives++;
         } else {
-            // 获取目录
-            auto folderPos = this->getFilePos(folderPath);
-            auto folderFile = _diskEntity->fileAt(folderPos);
-            assert(folderFile->inode.getType() == INode::Folder, "FSController::createDir", "目标不为文件夹");
-            head = IByteable::fromBytes<u_int64>(folderFile->data);
-            if (head == UNDEFINED) {
-                // 目录为空
-                folderFile->data = IByteable::toBytes(createPos);
-                _diskEntity->updateWithoutSizeChange(folderPos, *folderFile);
-                return createPos;
-            }
+            // 过滤器确认不存在同名项目，直接使用记录的链表尾部
+            _folderIndexStats.filtered++;
         }
 
-        u_int64 next = _diskEntity->fileAt(head)->inode.next;
+        // 新节点优先放在上一个同级项目附近，目录为空时放在目录节点附近
+        auto near = tailPos != UNDEFINED ? tailPos : folder.position;
 
-        while (next != UNDEFINED) {
-            head = next;
-            next = _diskEntity->fileAt(head)->inode.next;
+        if (packable && data != nullptr && packs(iNode.size)) {
+            // 小文件追加到目录末尾的打包节点，放不下时在末尾新建打包节点
+            auto record = DiskEntity::packedRecord(iNode, *data);
+
+            if (tailPos != UNDEFINED && _diskEntity->typeAt(tailPos) == INode::Pack) {
+                auto position = _diskEntity->appendPacked(tailPos, record);
+                if (position != UNDEFINED) {
+                    index.bloom.add(iNode.name);
+                    persistFolderIndex(folder.position, index);
+                    return {position, true};
+                }
+            }
+
+            auto packPos = _diskEntity->createPack(record, PACK_CAPACITY, UNDEFINED, near);
+
+            if (packPos != UNDEFINED) {
+                linkChild(folder, index, tailPos, packPos, iNode.name);
+                if (tailPos == UNDEFINED) folder.head = packPos;
+                return {_diskEntity->dataPos(packPos), true};
+            }
         }
 
-        _diskEntity->updateNextAt(head, createPos);
-        return createPos;
+        // 未给出数据时只按大小预留节点，数据由调用者随后写入
+        auto newPos = data != nullptr ? _diskEntity->addFile(iNode, *data, near) : _diskEntity->reserveFile(iNode, near);
+
+        if (newPos == UNDEFINED) return {UNDEFINED, false};
+
+        linkChild(folder, index, tailPos, newPos, iNode.name);
+
+        if (tailPos == UNDEFINED) folder.head = newPos;
+
+        return {newPos, true};
     }
 
-    std::list<INode> FSController::getDir(const std::list<std::string> &filePath) {
+    u_int64 FSController::createOrOpen(const std::list<std::string> &_folderPath, std::string fileName,
+                                       const ByteArray &data, INode::PermissionGroup permission, bool *created) {
 
-        u_int64 head;
+        assertLogin();
 
-        if (filePath.empty()) {
-            head = _diskEntity->root();
-        } else {
-            auto targetFolder = getFilePos(filePath);
-            assert(_diskEntity->fileINodeAt(targetFolder).getType() == INode::Folder);
-            head = IByteable::fromBytes<u_int64>(_diskEntity->fileAt(targetFolder)->data);
-        }
+        auto res = insertChild(
+                _folderPath,
+                INode{std::move(fileName), data.size(), permission, INode::FILE_TYPE, 0, UNDEFINED},
+                data,
+                true,
+                "FSController::createOrOpen"
+        );
+
+        assert(res.position != UNDEFINED, "FSController::createOrOpen", "磁盘已满！");
+
+        if (created != nullptr) *created = res.created;
+
+        return res.position;
+    }
+
+    std::list<INode> FSController::getDir(const std::list<std::string> &filePath, bool withSize) {
+
+        u_int64 head = resolveFolder(filePath).head;
 
         std::list<INode> res{};
 
         while (head != UNDEFINED) {
             INode iNode = _diskEntity->fileINodeAt(head);
+            if (iNode.getType() == INode::Pack) {
+                // 打包节点展开为其中的各个小文件
+                for (auto &it: _diskEntity->packedAt(head)) res.push_back(std::move(it.inode));
+                head = iNode.next;
+                continue;
+            }
+            if (withSize && (iNode.getType() == INode::Clone || iNode.getType() == INode::Extents)) {
+                // 克隆文件显示共享内容的大小，分段文件显示各段大小之和
+                iNode.size = DiskEntity::extentsSize(_diskEntity->contentExtents(head));
+            }
             res.push_back(iNode);
             head = iNode.next;
         }
@@ -199,7 +426,10 @@ namespace FileSystem {
     }
 
     INode FSController::getINodeByPath(const std::list<std::string> &folderPath) {
-        return _diskEntity->fileINodeAt(getFilePos(folderPath));
+        INode inode;
+        // 目标不存在时 getFilePos 会直接抛出，这里只需要其填写的 inode
+        (void) getFilePos(folderPath, &inode);
+        return inode;
     }
 
     u_int64
@@ -208,205 +438,942 @@ namespace FileSystem {
 
         assertLogin();
 
-        auto dirFiles = getDir(fixPath(_folderPath));
+        auto res = insertChild(
+                _folderPath,
+                INode{std::move(fileName), data.size(), permission, INode::FILE_TYPE, 0, UNDEFINED},
+                data,
+                false,
+                "FSController::createFile",
+                true
+        );
+
+        assert(res.position != UNDEFINED, "FSController::createFile", "磁盘已满！");
+
+        return res.position;
+    }
+
+    u_int64 FSController::uploadFile(const std::string &hostPath, const std::list<std::string> &_folderPath,
+                                     std::string fileName, INode::PermissionGroup permission) {
+
+        assertLogin();
+
+        assert(std::filesystem::is_regular_file(hostPath), "FSController::uploadFile", "外部文件不存在：" + hostPath);
+
+        auto size = std::filesystem::file_size(hostPath);
+
+        auto folder = resolveFolder(_folderPath);
+
+        if (packs(size)) {
+            // 小文件整体读入后存入打包节点
+            auto data = FileLinker::readHost(hostPath, size);
+            auto res = insertInto(folder, INode{fileName, size, permission, INode::FILE_TYPE, 0, UNDEFINED}, &data,
+                                  false, "FSController::uploadFile", true);
+            assert(res.position != UNDEFINED, "FSController::uploadFile", "磁盘已满！");
+            return size;
+        }
+
+        // 按外部文件大小预留节点，再分块直接写入数据区域，内存占用与文件大小无关
+        auto res = insertInto(folder, INode{fileName, size, permission, INode::FILE_TYPE, 0, UNDEFINED}, nullptr,
+                              false, "FSController::uploadFile");
+
+        assert(res.position != UNDEFINED, "FSController::uploadFile", "磁盘已满！");
+
+        try {
+            _diskEntity->importExtents(hostPath, _diskEntity->contentExtents(res.position));
+        } catch (Error &e) {
+            // 写入失败时删除只写入了一部分的文件
+            auto filePath = _folderPath;
+            filePath.push_back(std::move(fileName));
+            removeFile(filePath);
+            throw e;
+        }
+
+        return size;
+    }
+
+    void FSController::printStructure(std::ostream &os) {
+        // 统计需要对齐的文件内容中有多少从对齐位置开始，以及这些内容之前因对齐而无法使用的空闲区域
+        u_int64 payloads = 0, aligned = 0, padding = 0;
+        u_int64 lastEmpty = 0;
+
+        for (const auto &item: _diskEntity->getAll()) {
+            if (item.type == NodeType::File) {
+                os << item.ptr.file->toString(item.position);
+
+                const auto &inode = item.ptr.file->inode;
+                auto type = inode.getType();
+
+                if (inode.size >= DiskEntity::DATA_ALIGNMENT &&
+                    (type == INode::UserFile || type == INode::ExtentData || type == INode::SharedData)) {
+                    payloads++;
+                    if ((item.position + FileNode::headerSizeFor(inode)) % DiskEntity::DATA_ALIGNMENT == 0) {
+                        aligned++;
+                        padding += alignmentGap(lastEmpty, inode.layout().minEmptySize);
+                    }
+                }
+
+                lastEmpty = 0;
+            } else if (item.type == NodeType::Empty) {
+                os << item.ptr.empty->toString(item.position);
+                lastEmpty = item.ptr.empty->emptySize;
+            }
+            os << endl;
+        }
+
+        os << "内容对齐：" << (_diskEntity->alignedData() ? "开启" : "关闭") << "，" << aligned << " / " << payloads
+           << " 个不小于 " << DiskEntity::DATA_ALIGNMENT << " 字节的文件内容从对齐位置开始，其前方因对齐留出 "
+           << padding << " 字节" << endl;
+
+        auto stats = getLayoutStats();
+        os << "同级项目平均距离：" << stats.averageSiblingDistance() << " 字节（" << stats.siblingPairs << " 对相邻项目）"
+           << endl;
+    }
+
+    void FSController::removeFile(const std::list<std::string> &_filePath, bool ignoreFolder, std::ostream *os) {
+
+        assertLogin();
+
+        if (os != nullptr) {
+            *os << "删除： " << pathStr(_filePath, false) << endl;
+        }
+
+        auto position = detachChild(fixPath(_filePath), ignoreFolder);
+
+        // 打包文件已在摘除时从打包节点中移除
+        if (position == UNDEFINED) return;
+
+        if (_lazyDelete) {
+            _reclaimer.submit(position);
+        } else {
+            _diskEntity->removeFileAt(position);
+        }
+    }
+
+    FSController::ChildRef FSController::locateChild(std::list<std::string> filePath, const std::string &func) {
+
+        auto fileName = filePath.back();
+        filePath.pop_back();
+
+        auto folder = resolveFolder(filePath);
+
+        assert(folderIndex(folder).bloom.mayContain(fileName), func, "目标文件不存在");
+
+        // 单次遍历，找到目标项目及其前一个项目
+        u_int64 lastFilePos = UNDEFINED;
+        u_int64 thisFilePos = folder.head;
+        auto nameHash = INode::hashName(fileName);
+
+        while (thisFilePos != UNDEFINED) {
+            u_int64 next;
+            bool pack;
+            if (_diskEntity->matchNameAt(thisFilePos, fileName, nameHash, next, &pack)) break;
+
+            if (pack) {
+                INode iNode;
+                auto position = findPacked(thisFilePos, fileName, &iNode);
+                if (position != UNDEFINED) return {folder, lastFilePos, position, std::move(iNode), thisFilePos};
+            }
+
+            lastFilePos = thisFilePos;
+            thisFilePos = next;
+        }
+
+        assert(thisFilePos != UNDEFINED, func, "目标文件不存在");
+
+        return {folder, lastFilePos, thisFilePos, _diskEntity->fileINodeAt(thisFilePos)};
+    }
+
+    u_int64 FSController::detachChild(std::list<std::string> filePath, bool ignoreFolder) {
 
         assert(
-                !std::any_of(
-                        dirFiles.begin(),
-                        dirFiles.end(),
-                        [&fileName](const INode &it) -> bool {
-                            return it.name == fileName;
-                        }
-                ),
-                "FSController::createFile",
-                "当前目录下已存在相同文件名的项目！"
+                !filePath.empty(),
+                "FSController::removeFile",
+                "无法删除根目录！"
         );
 
-        bool intoRoot = false;
+        auto child = locateChild(std::move(filePath), "FSController::removeFile");
+
+        if (!ignoreFolder) {
+            assert(child.inode.isFile(), "FSController::removeFile", "目标项目不为文件");
+        }
+
+        assert(child.inode.assertPermission(INode::Edit, role), "FSController::removeFile", "没有足够的权限！");
+
+        assert(!_leases.isHeld(child.position), "FSController::removeFile", "该文件正在被其他用户使用");
+
+        if (child.pack != UNDEFINED) {
+            removePacked(child);
+            return UNDEFINED;
+        }
+
+        invalidateHandles(child.position);
+
+        unlinkChild(child.folder, child.lastPos, child.position, child.inode);
 
-        u_int64 targetFolder;
+        return child.position;
+    }
+
+    void FSController::linkChild(const FSController::FolderRef &folder, FolderIndex &index, u_int64 tailPos,
+                                 u_int64 position, const std::string &name) {
 
-        if (_folderPath.empty()) {
-            intoRoot = true;
+        // 将项目链接到目录末尾
+        if (tailPos != UNDEFINED) {
+            _diskEntity->updateNextAt(tailPos, position);
+        } else if (folder.position == UNDEFINED) {
+            _diskEntity->setRoot(position);
         } else {
-            targetFolder = getFilePos(_folderPath);
+            _diskEntity->updateFolderHeadAt(folder.position, position);
         }
 
-        auto newFilePos = _diskEntity->addFile(
-                INode{
-                        std::move(fileName),
-                        data.size(),
-                        permission,
-                        std::byte{0},
-                        0,
-                        UNDEFINED
-                },
-                data
+        index.tail = position;
+        index.bloom.add(name);
+        persistFolderIndex(folder.position, index);
+    }
+
+    void FSController::move(const std::list<std::string> &_srcPath, const std::list<std::string> &_dstPath) {
+
+        assertLogin();
+
+        auto srcPath = fixPath(_srcPath);
+
+        assert(!srcPath.empty(), "FSController::move", "无法移动根目录");
+
+        std::list<std::string> dstFolderPath;
+        std::string dstName;
+        splitTarget(srcPath, fixPath(_dstPath), dstFolderPath, dstName);
+
+        auto src = locateChild(srcPath, "FSController::move");
+
+        assert(src.inode.assertPermission(INode::Edit, role), "FSController::move", "没有足够的权限！");
+
+        assert(!_leases.isHeld(src.position), "FSController::move", "该文件正在被其他用户使用");
+
+        assert(
+                src.inode.getType() != INode::Folder || !isUnder(dstFolderPath, srcPath),
+                "FSController::move",
+                "无法将文件夹移动到其自身之下"
         );
 
-        assert(newFilePos != UNDEFINED, "FSController::createFile", "磁盘已满！");
+        assert(findChild(resolveFolder(dstFolderPath), dstName) == UNDEFINED, "FSController::move",
+               "目标目录下已存在相同文件名的项目！");
 
-        if (intoRoot) {
+        if (src.pack != UNDEFINED) {
+            // 打包文件先解包为独立的文件节点再移动
+            unpackChild(src, "FSController::move");
+            src = locateChild(srcPath, "FSController::move");
+        }
+
+        auto position = src.position;
+
+        // 名称长度变化会改变 inode 大小，需要新的目录项；普通文件的节点原地转为分段节点，数据不移动
+        bool inPlace = dstName.size() == src.inode.name.size();
+        bool keepsData = !inPlace && src.inode.getType() == INode::UserFile;
+
+        if (inPlace) {
+            if (dstName != src.inode.name) _diskEntity->renameAt(position, dstName);
+        } else if (keepsData) {
+            auto entry = src.inode;
+            entry.name = dstName;
+            entry.type = INode::EXTENTS_TYPE;
+            entry.size = sizeof(u_int64);
+            entry.openCounter = 0;
+            entry.next = UNDEFINED;
+            position = _diskEntity->addFile(entry, IByteable::toBytes(src.position));
+            assert(position != UNDEFINED, "FSController::move", "磁盘已满！");
+        } else {
+            // 文件夹、克隆与分段文件的数据只是少量位置信息，连同 inode 一起复制
+            auto node = _diskEntity->fileAt(position);
+            node->inode.name = dstName;
+            node->inode.next = UNDEFINED;
+            position = _diskEntity->addFile(node->inode, node->data);
+            assert(position != UNDEFINED, "FSController::move", "磁盘已满！");
+            delete node;
+        }
 
-            auto headPos = _diskEntity->root();
+        unlinkChild(src.folder, src.lastPos, src.position, src.inode);
 
-            if (headPos == UNDEFINED) {
-                _diskEntity->setRoot(newFilePos);
-            } else {
-                INode inode = _diskEntity->fileINodeAt(headPos);
-                while (inode.next != UNDEFINED) {
-                    headPos = inode.next;
-                    inode = _diskEntity->fileINodeAt(headPos);
+        bool movingWorkDir = _workDir.position == src.position;
+
+        if (keepsData) {
+            invalidateHandles(src.position);
+            _diskEntity->extentFileAt(src.position);
+        } else if (position != src.position) {
+            // 新目录项引用同一共享数据节点或分段节点，只释放旧目录项本身
+            invalidateHandles(src.position);
+            _diskEntity->removeFileAt(src.position, false);
+        } else {
+            _diskEntity->updateNextAt(position, UNDEFINED);
+        }
+
+        // 位于被移动项目之下的句柄与工作目录改用新路径
+        auto newPath = dstFolderPath;
+        newPath.push_back(dstName);
+        rebasePaths(srcPath, newPath);
+
+        if (movingWorkDir) {
+            _workDir = {newPath, position};
+        }
+
+        auto dstFolder = resolveFolder(dstFolderPath);
+        auto &index = folderIndex(dstFolder);
+        linkChild(dstFolder, index, index.tail, position, dstName);
+    }
+
+    void FSController::splitTarget(const std::list<std::string> &srcPath, const std::list<std::string> &dstPath,
+                                   std::list<std::string> &dstFolderPath, std::string &dstName) const {
+
+        // 目标为已存在的文件夹时放入其中并保留原名，否则目标路径的最后一段为新名称
+        dstName = srcPath.back();
+        dstFolderPath = dstPath;
+
+        if (dstPath.empty()) return;
+
+        auto dstParentPath = dstPath;
+        dstParentPath.pop_back();
+
+        INode dstINode;
+        auto dstPos = findChild(resolveFolder(dstParentPath), dstPath.back(), &dstINode);
+
+        if (dstPos == UNDEFINED || dstINode.getType() != INode::Folder) {
+            dstName = dstPath.back();
+            dstFolderPath = dstParentPath;
+        }
+    }
+
+    bool FSController::isUnder(const std::list<std::string> &path, const std::list<std::string> &folderPath) {
+        return path.size() >= folderPath.size() && std::equal(folderPath.begin(), folderPath.end(), path.begin());
+    }
+
+    FSController::CopyResult FSController::copy(const std::list<std::string> &_srcPath,
+                                                const std::list<std::string> &_dstPath, bool recursive) {
+
+        assertLogin();
+
+        auto srcPath = fixPath(_srcPath);
+
+        assert(!srcPath.empty(), "FSController::copy", "无法复制根目录");
+
+        std::list<std::string> dstFolderPath;
+        std::string dstName;
+        splitTarget(srcPath, fixPath(_dstPath), dstFolderPath, dstName);
+
+        auto src = locateChild(srcPath, "FSController::copy");
+
+        assert(src.inode.assertPermission(INode::Read, role), "FSController::copy", "没有足够的权限！");
+
+        if (src.inode.getType() == INode::Folder) {
+            assert(recursive, "FSController::copy", "源项目为文件夹，请使用 cp -r");
+            assert(!isUnder(dstFolderPath, srcPath), "FSController::copy", "无法将文件夹复制到其自身之下");
+        }
+
+        auto dstFolder = resolveFolder(dstFolderPath);
+
+        assert(findChild(dstFolder, dstName) == UNDEFINED, "FSController::copy", "目标目录下已存在相同文件名的项目！");
+
+        // 先按已知大小预留全部目标节点并建立目录结构，再统一搬运数据
+        CopyResult result{};
+        std::vector<CopyJob> jobs{};
+        std::vector<u_int64> leased{};
+
+        auto releaseSources = [&]() {
+            for (auto position: leased) _leases.releaseShared(position);
+        };
+
+        try {
+            copyEntry(src.position, src.inode, dstFolder, dstName, jobs, leased, result);
+
+            runParallel(jobs.size(), [&](std::size_t index) {
+                _diskEntity->copyRange(jobs[index].from, jobs[index].to, jobs[index].size);
+            });
+        } catch (...) {
+            // 目标项目在复制前不存在，中途失败时整体删除已经建立的部分，不留下内容尚未写入的节点
+            releaseSources();
+            discardEntry(dstFolderPath, dstName);
+            throw;
+        }
+
+        releaseSources();
+
+        return result;
+    }
+
+    FSController::CopyResult FSController::importTree(const std::string &hostDir,
+                                                      const std::list<std::string> &_dstPath) {
+
+        assertLogin();
+
+        auto root = std::filesystem::absolute(hostDir).lexically_normal();
+        if (!root.has_filename()) root = root.parent_path();
+
+        assert(std::filesystem::is_directory(root), "FSController::importTree", "外部目录不存在：" + hostDir);
+
+        std::list<std::string> dstFolderPath;
+        std::string dstName;
+        splitTarget({root.filename().string()}, fixPath(_dstPath), dstFolderPath, dstName);
+
+        // 按层遍历外部目录，父目录总在子项目之前，同时统计所需空间（包括导入后的根目录节点）
+        std::vector<ImportEntry> entries{{root.string(), dstName, FOLDER_DATA_SIZE, true, {}}};
+        INode rootINode{dstName, FOLDER_DATA_SIZE, INode::OpenPermission, INode::FOLDER_TYPE, 0, UNDEFINED};
+        u_int64 required = _diskEntity->nodeSizeFor(rootINode);
+
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i].folder) continue;
+
+            std::vector<ImportEntry> children{};
+
+            for (const auto &it: std::filesystem::directory_iterator(entries[i].hostPath)) {
+                bool folder = it.is_directory();
+                if (!folder && !it.is_regular_file()) continue;
+
+                auto name = it.path().filename().string();
+                assert(name.size() <= 0xff, "FSController::importTree", "文件名过长：" + it.path().string());
+
+                children.push_back({it.path().string(), name, folder ? FOLDER_DATA_SIZE : it.file_size(), folder, {}});
+            }
+
+            std::sort(children.begin(), children.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+
+            u_int64 packed = 0;
+
+            for (auto &child: children) {
+                if (!child.folder && packs(child.size)) {
+                    packed += PACKED_HEADER_SIZE + child.name.size() + child.size;
+                } else {
+                    required += _diskEntity->nodeSizeFor(
+                            INode{child.name, child.size, INode::OpenPermission, INode::FILE_TYPE, 0, UNDEFINED});
                 }
-                _diskEntity->updateNextAt(headPos, newFilePos);
+                entries[i].children.push_back(entries.size());
+                entries.push_back(std::move(child));
             }
 
-        } else {
-            auto folder = _diskEntity->fileAt(targetFolder);
+            // 小文件按打包节点的容量分组存放
+            if (packed > 0) {
+                required += packed + (packed / PACK_CAPACITY + 1) * _diskEntity->nodeSizeFor(
+                        INode{"", 0, INode::OpenPermission, INode::PACK_TYPE, 0, UNDEFINED});
+            }
+        }
+
+        auto available = _diskEntity->freeSize();
+
+        assert(required <= available, "FSController::importTree",
+               "磁盘空间不足：需要 " + std::to_string(required) + " 字节，剩余 " + std::to_string(available) + " 字节");
+
+        auto dstFolder = resolveFolder(dstFolderPath);
+
+        auto folderData = emptyFolderData();
+        auto res = insertInto(dstFolder, rootINode, &folderData, false, "FSController::importTree");
+        assert(res.position != UNDEFINED, "FSController::importTree", "磁盘已满！");
+
+        // 先分配全部节点并建立目录结构，文件只按大小预留，数据随后由多个线程并行读入
+        CopyResult result{0, 1, 0};
+        std::vector<u_int64> positions(entries.size(), UNDEFINED);
+        std::vector<std::pair<std::size_t, std::vector<Extent>>> jobs{};
+
+        positions[0] = res.position;
+
+        // 估算无法计入碎片、分段与对齐，分配仍可能失败；当前目录中已分配但尚未挂接的节点记录在此，失败时一并释放
+        std::vector<u_int64> unlinked{};
 
-            auto headPos = IByteable::fromBytes<u_int64>(folder->data);
+        try {
+            for (std::size_t i = 0; i < entries.size(); i++) {
+                const auto &entry = entries[i];
+                if (!entry.folder || entry.children.empty()) continue;
+
+                // 子项目按逆序分配，分配时下一个同级项目已经确定，链表无需回写
+                u_int64 next = UNDEFINED;
+                u_int64 tail = UNDEFINED;
+                auto bloom = BloomFilter::forEntries(entry.children.size());
+
+                // 小文件的记录按逆序前插，写满一个打包节点后整体分配
+                ByteArray records{};
+                auto flushPack = [&]() {
+                    if (records.size() == 0) return;
+                    next = _diskEntity->createPack(records, records.size(), next,
+                                                   next != UNDEFINED ? next : positions[i]);
+                    assert(next != UNDEFINED, "FSController::importTree", "磁盘已满！");
+                    unlinked.push_back(next);
+                    if (tail == UNDEFINED) tail = next;
+                    records = ByteArray();
+                };
+
+                for (auto it = entry.children.rbegin(); it != entry.children.rend(); it++) {
+                    const auto &child = entries[*it];
+
+                    if (!child.folder && packs(child.size)) {
+                        INode iNode{child.name, child.size, INode::OpenPermission, INode::FILE_TYPE, 0, UNDEFINED};
+                        auto record = DiskEntity::packedRecord(iNode, FileLinker::readHost(child.hostPath, child.size));
+
+                        if (records.size() + record.size() > PACK_CAPACITY) flushPack();
+                        records = record.append(records);
+
+                        result.files++;
+                        result.bytes += child.size;
+                        bloom.add(child.name);
+                        continue;
+                    }
+
+                    INode iNode{child.name, child.size, INode::OpenPermission,
+                                child.folder ? INode::FOLDER_TYPE : INode::FILE_TYPE, 0, next};
+
+                    // 逆序分配时紧挨着已分配的后一个同级项目，第一个靠近目录节点
+                    auto near = next != UNDEFINED ? next : positions[i];
+                    auto position = child.folder ? _diskEntity->addFile(iNode, emptyFolderData(), near)
+                                                 : _diskEntity->reserveFile(iNode, near);
+                    assert(position != UNDEFINED, "FSController::importTree", "磁盘已满！");
+                    unlinked.push_back(position);
+
+                    if (child.folder) {
+                        result.folders++;
+                    } else {
+                        jobs.emplace_back(*it, _diskEntity->contentExtents(position));
+                        result.files++;
+                        result.bytes += child.size;
+                    }
+
+                    positions[*it] = position;
+                    bloom.add(child.name);
+                    next = position;
+                    if (tail == UNDEFINED) tail = position;
+                }
+
+                flushPack();
+
+                // 整个目录的子项目链表一次挂接，名称过滤器与链表尾部一次写入
+                _diskEntity->updateFolderHeadAt(positions[i], next);
+                unlinked.clear();
+
+                auto &index = _folderIndex.insert_or_assign(
+                        positions[i], FolderIndex{tail, std::move(bloom), true}).first->second;
+                persistFolderIndex(positions[i], index);
+            }
+
+            runParallel(jobs.size(), [&](std::size_t index) {
+                _diskEntity->importExtents(entries[jobs[index].first].hostPath, jobs[index].second);
+            });
+        } catch (...) {
+            // 已挂接的部分随导入的根目录一并删除
+            _diskEntity->removeFilesAt(std::move(unlinked));
+            discardEntry(dstFolderPath, dstName);
+            throw;
+        }
 
-            if (headPos == UNDEFINED) {
-                folder->data = IByteable::toBytes(newFilePos);
-                _diskEntity->updateWithoutSizeChange(targetFolder, *folder);
+        return result;
+    }
+
+    void FSController::copyEntry(u_int64 srcPos, const INode &srcINode, FSController::FolderRef &dstFolder,
+                                 const std::string &name, std::vector<CopyJob> &jobs, std::vector<u_int64> &leased,
+                                 CopyResult &result) {
+
+        auto iNode = srcINode;
+        iNode.name = name;
+        iNode.next = UNDEFINED;
+        iNode.openCounter = 0;
+
+        if (srcINode.getType() != INode::Folder) {
+            // 复制期间持有源文件的共享租约，正在被编辑的文件不会被复制到一半
+            assert(_leases.acquireShared(srcPos), "FSController::copy", "该文件正在被其他用户写：" + srcINode.name);
+            leased.push_back(srcPos);
+        }
+
+        if (srcINode.getType() == INode::Clone) {
+            // 克隆文件的副本仍引用同一共享数据节点
+            auto sharedPos = _diskEntity->sharedOf(srcPos);
+            auto data = IByteable::toBytes(sharedPos);
+            auto res = insertInto(dstFolder, iNode, &data, false, "FSController::copy");
+            assert(res.position != UNDEFINED, "FSController::copy", "磁盘已满！");
+
+            _diskEntity->retainSharedAt(sharedPos);
+
+            result.files++;
+            result.bytes += DiskEntity::extentsSize(_diskEntity->contentExtents(srcPos));
+            return;
+        }
+
+        if (srcINode.getType() != INode::Folder) {
+            // 源文件与副本各自可能为分段文件，按两边的分段边界切分搬运
+            auto srcExtents = contentOf(srcPos, srcINode);
+            iNode.type = INode::FILE_TYPE;
+            iNode.size = DiskEntity::extentsSize(srcExtents);
+
+            if (packs(iNode.size)) {
+                auto data = _diskEntity->readExtents(srcExtents, 0, iNode.size);
+                auto res = insertInto(dstFolder, iNode, &data, false, "FSController::copy", true);
+                assert(res.position != UNDEFINED, "FSController::copy", "磁盘已满！");
+                result.files++;
+                result.bytes += iNode.size;
+                return;
+            }
+
+            auto res = insertInto(dstFolder, iNode, nullptr, false, "FSController::copy");
+            assert(res.position != UNDEFINED, "FSController::copy", "磁盘已满！");
+
+            DiskEntity::pairExtents(srcExtents, _diskEntity->contentExtents(res.position),
+                                    [&](u_int64 from, u_int64 to, u_int64 size) { jobs.push_back({from, to, size}); });
+            result.files++;
+            result.bytes += iNode.size;
+            return;
+        }
+
+        iNode.size = FOLDER_DATA_SIZE;
+
+        auto folderData = emptyFolderData();
+        auto res = insertInto(dstFolder, iNode, &folderData, false, "FSController::copy");
+        assert(res.position != UNDEFINED, "FSController::copy", "磁盘已满！");
+
+        result.folders++;
+
+        FolderRef folder{res.position, UNDEFINED};
+
+        for (auto position = _diskEntity->folderHeadAt(srcPos); position != UNDEFINED;) {
+            auto childINode = _diskEntity->fileINodeAt(position);
+
+            // 打包节点中的各个小文件逐个复制
+            std::vector<PackedFile> children{};
+            if (childINode.getType() == INode::Pack) {
+                children = _diskEntity->packedAt(position);
             } else {
-                INode inode = _diskEntity->fileINodeAt(headPos);
-                while (inode.next != UNDEFINED) {
-                    headPos = inode.next;
-                    inode = _diskEntity->fileINodeAt(headPos);
+                children.push_back({position, childINode});
+            }
+
+            for (auto &it: children) {
+                assert(it.inode.assertPermission(INode::Read, role), "FSController::copy",
+                       "没有足够的权限：" + it.inode.name);
+
+                copyEntry(it.position, it.inode, folder, it.inode.name, jobs, leased, result);
+            }
+
+            position = childINode.next;
+        }
+    }
+
+    FSController::CopyResult FSController::exportTree(const std::list<std::string> &_srcPath,
+                                                      const std::string &hostDir) {
+
+        assertLogin();
+
+        auto srcPath = fixPath(_srcPath);
+
+        // 外部目标为已存在的目录时导出到其中，否则以其为导出后的路径；根目录直接导出其内容
+        std::filesystem::path target{hostDir};
+        if (!srcPath.empty() && std::filesystem::is_directory(target)) {
+            target /= srcPath.back();
+        }
+
+        u_int64 srcPos = UNDEFINED;
+        INode srcINode{"", FOLDER_DATA_SIZE, INode::OpenPermission, INode::FOLDER_TYPE, 0, UNDEFINED};
+
+        if (!srcPath.empty()) {
+            auto src = locateChild(srcPath, "FSController::exportTree");
+            srcPos = src.position;
+            srcINode = src.inode;
+        }
+
+        // 先遍历整棵子树：按层创建外部目录并收集文件的数据位置，再由多个线程并行写出
+        CopyResult result{};
+        std::vector<ExportJob> jobs{};
+        std::deque<std::tuple<u_int64, INode, std::filesystem::path>> pending{{srcPos, srcINode, target}};
+
+        while (!pending.empty()) {
+            auto [position, iNode, hostPath] = std::move(pending.front());
+            pending.pop_front();
+
+            assert(iNode.assertPermission(INode::Read, role), "FSController::exportTree",
+                   "没有足够的权限：" + iNode.name);
+
+            if (iNode.isFile()) {
+                auto extents = contentOf(position, iNode);
+                result.files++;
+                result.bytes += DiskEntity::extentsSize(extents);
+                jobs.push_back({hostPath.string(), std::move(extents)});
+                continue;
+            }
+
+            if (iNode.getType() != INode::Folder) continue;
+
+            std::filesystem::create_directories(hostPath);
+            result.folders++;
+
+            auto head = position == UNDEFINED ? _diskEntity->root() : _diskEntity->folderHeadAt(position);
+
+            for (; head != UNDEFINED;) {
+                auto childINode = _diskEntity->fileINodeAt(head);
+                if (childINode.getType() == INode::Pack) {
+                    for (auto &it: _diskEntity->packedAt(head)) {
+                        auto childPath = hostPath / it.inode.name;
+                        pending.emplace_back(it.position, std::move(it.inode), std::move(childPath));
+                    }
+                } else {
+                    auto childPath = hostPath / childINode.name;
+                    pending.emplace_back(head, childINode, std::move(childPath));
                 }
-                _diskEntity->updateNextAt(headPos, newFilePos);
+                head = childINode.next;
+            }
+        }
+
+        runParallel(jobs.size(), [&](std::size_t index) {
+            _diskEntity->exportExtents(jobs[index].extents, jobs[index].hostPath);
+        });
+
+        return result;
+    }
+
+    void FSController::runParallel(std::size_t count, const std::function<void(std::size_t)> &func) {
+
+        if (count < PARALLEL_COPY_MIN_FILES) {
+            for (std::size_t i = 0; i < count; i++) {
+                func(i);
             }
+            return;
         }
 
-        return newFilePos;
-    }
+        // 文件较多时由多个线程并行搬运，各线程使用独立的文件流，目标区域互不重叠
+        auto workers = std::min(std::max(std::thread::hardware_concurrency(), 1u), MAX_COPY_WORKERS);
+
+        std::atomic<std::size_t> next{0};
+        std::exception_ptr failure{};
+        std::mutex failureMutex{};
+        std::vector<std::thread> pool{};
+
+        for (unsigned int i = 0; i < workers; i++) {
+            pool.emplace_back([&] {
+                try {
+                    for (auto index = next++; index < count; index = next++) {
+                        func(index);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard{failureMutex};
+                    if (!failure) failure = std::current_exception();
+                }
+            });
+        }
+
+        for (auto &it: pool) it.join();
+
+        if (failure) std::rethrow_exception(failure);
+    }
+
+    void FSController::clone(const std::list<std::string> &_srcPath, const std::list<std::string> &_dstPath) {
+
+        assertLogin();
+
+        auto srcPath = fixPath(_srcPath);
+
+        assert(!srcPath.empty(), "FSController::clone", "无法克隆根目录");
+
+        std::list<std::string> dstFolderPath;
+        std::string dstName;
+        splitTarget(srcPath, fixPath(_dstPath), dstFolderPath, dstName);
+
+        auto src = locateChild(srcPath, "FSController::clone");
+
+        assert(src.inode.assertPermission(INode::Read, role), "FSController::clone", "没有足够的权限！");
+
+        assert(src.inode.isFile(), "FSController::clone", "只能克隆文件");
+
+        // 源文件尚不是克隆时需要原地改写其目录项（解包、转为共享数据节点），只有读权限时不允许
+        assert(src.inode.getType() == INode::Clone || src.inode.assertPermission(INode::Edit, role),
+               "FSController::clone", "没有修改源文件的权限，只能克隆已经是克隆的文件");
+
+        // 只有一段的分段文件（元数据分离布局下的文件）可将该段原地转为共享数据节点
+        assert(src.inode.getType() != INode::Extents || _diskEntity->extentNodesAt(src.position).size() == 1,
+               "FSController::clone", "分段存储的文件无法克隆");
+
+        assert(findChild(resolveFolder(dstFolderPath), dstName) == UNDEFINED, "FSController::clone",
+               "目标目录下已存在相同文件名的项目！");
+
+        if (src.pack != UNDEFINED) {
+            // 打包文件先解包为独立的文件节点，再原地转为共享数据节点
+            assert(!_leases.isHeld(src.position), "FSController::clone", "该文件正在被其他用户使用");
+            unpackChild(src, "FSController::clone");
+            src = locateChild(srcPath, "FSController::clone");
+        }
+
+        auto entry = src.inode;
+        entry.type = INode::CLONE_TYPE;
+        entry.size = sizeof(u_int64);
+        entry.openCounter = 0;
+        entry.next = UNDEFINED;
+
+        u_int64 sharedPos;
+
+        if (src.inode.getType() == INode::Clone) {
+            sharedPos = _diskEntity->sharedOf(src.position);
+        } else {
+            // 源文件的节点原地转为共享数据节点，源目录项改为指向它的克隆，数据不移动
+            assert(!_leases.isHeld(src.position), "FSController::clone", "该文件正在被其他用户使用");
 
-    void FSController::printStructure(std::ostream &os) {
-        for (const auto &item: _diskEntity->getAll()) {
-            if (item.type == NodeType::File) {
-                os << item.ptr.file->toString(item.position);
-            } else if (item.type == NodeType::Empty) {
-                os << item.ptr.empty->toString(item.position);
-            }
-            os << endl;
-        }
-    }
+            sharedPos = src.inode.getType() == INode::Extents ? _diskEntity->extentNodesAt(src.position).front()
+                                                              : src.position;
 
-    void FSController::removeFile(const std::list<std::string> &_filePath, bool ignoreFolder, std::ostream *os) {
+            auto entryPos = _diskEntity->addFile(entry, IByteable::toBytes(sharedPos));
+            assert(entryPos != UNDEFINED, "FSController::clone", "磁盘已满！");
 
-        assertLogin();
+            replaceChild(src, entryPos);
+            _diskEntity->shareFileAt(sharedPos);
 
-        if (os != nullptr) {
-            *os << "删除： " << pathStr(_filePath, false) << endl;
+            // 分段文件原来的目录项不再被引用
+            if (sharedPos != src.position) _diskEntity->removeFileAt(src.position, false);
         }
 
-        auto filePath = _filePath;
+        entry.name = dstName;
 
-        assert(
-                !filePath.empty(),
-                "FSController::removeFile",
-                "无法删除根目录！"
-        );
+        auto data = IByteable::toBytes(sharedPos);
+        auto dstFolder = resolveFolder(dstFolderPath);
+        auto res = insertInto(dstFolder, entry, &data, false, "FSController::clone");
+        assert(res.position != UNDEFINED, "FSController::clone", "磁盘已满！");
 
-        assert(
-                _diskEntity->fileINodeAt(getFilePos(filePath)).assertPermission(INode::Edit, role),
-                "FSController::removeDir",
-                "没有足够的权限！"
-        );
+        _diskEntity->retainSharedAt(sharedPos);
+    }
 
-        auto fileName = filePath.back();
-        filePath.pop_back();
+    void FSController::replaceChild(const FSController::ChildRef &child, u_int64 position) {
 
-        if (filePath.empty()) {
+        // 新节点接替原项目在同级链表中的位置，名称不变，过滤器无需更新
+        _diskEntity->updateNextAt(position, child.inode.next);
 
-            u_int64 lastFilePos = _diskEntity->root();
+        if (child.lastPos != UNDEFINED) {
+            _diskEntity->updateNextAt(child.lastPos, position);
+        } else if (child.folder.position == UNDEFINED) {
+            _diskEntity->setRoot(position);
+        } else {
+            _diskEntity->updateFolderHeadAt(child.folder.position, position);
+        }
 
-            INode headFileINode = _diskEntity->fileINodeAt(lastFilePos);
+        auto iter = _folderIndex.find(child.folder.position);
 
-            if (headFileINode.name == fileName) {
+        if (iter != _folderIndex.end() && iter->second.tail == child.position) {
+            iter->second.tail = position;
+            persistFolderIndex(child.folder.position, iter->second);
+        }
 
-                if (!ignoreFolder) {
-                    assert(headFileINode.getType() == INode::UserFile, "FSController::removeFile", "目标项目不为文件0");
-                }
+        invalidateHandles(child.position);
+    }
 
-                _diskEntity->setRoot(headFileINode.next);
-                _diskEntity->removeFileAt(lastFilePos);
+    u_int64 FSController::detachClone(const FSController::ChildRef &child) {
 
-                return;
-            }
+        auto srcExtents = _diskEntity->contentExtents(child.position);
 
-            u_int64 thisFilePos = headFileINode.next;
+        auto iNode = child.inode;
+        iNode.type = INode::FILE_TYPE;
+        iNode.size = DiskEntity::extentsSize(srcExtents);
+        iNode.openCounter = 0;
+        iNode.next = UNDEFINED;
 
-            INode thisFileINode;
+        auto position = _diskEntity->reserveFile(iNode, child.position);
+        assert(position != UNDEFINED, "FSController::open", "磁盘已满！");
 
-            while (thisFilePos != UNDEFINED) {
-                thisFileINode = _diskEntity->fileINodeAt(thisFilePos);
-                if (thisFileINode.name == fileName) break;
+        DiskEntity::pairExtents(srcExtents, _diskEntity->contentExtents(position),
+                                [&](u_int64 from, u_int64 to, u_int64 size) { _diskEntity->copyRange(from, to, size); });
 
-                lastFilePos = thisFilePos;
-                thisFilePos = thisFileINode.next;
-            }
+        replaceChild(child, position);
 
-            assert(thisFilePos != UNDEFINED, "FSController::removeFile", "目标文件不存在");
-            if (!ignoreFolder) {
-                assert(thisFileINode.getType() == INode::UserFile, "FSController::removeFile", "目标项目不为文件1");
-            }
+        // 释放克隆目录项，共享数据节点的引用计数随之减少
+        _diskEntity->removeFileAt(child.position);
+
+        return position;
+    }
+
+    void FSController::removePacked(const FSController::ChildRef &child) {
 
-            _diskEntity->updateNextAt(lastFilePos, thisFileINode.next);
-            _diskEntity->removeFileAt(thisFilePos);
+        auto remaining = _diskEntity->removePacked(child.pack, child.position);
 
+        if (remaining == 0) {
+            // 打包节点已空，与普通项目一样从目录中摘除并释放
+            unlinkChild(child.folder, child.lastPos, child.pack, _diskEntity->fileINodeAt(child.pack));
+            _diskEntity->removeFileAt(child.pack);
             return;
+        }
 
-        } else {
+        auto iter = _folderIndex.find(child.folder.position);
 
-            auto dirPos = getFilePos(filePath);
+        if (iter != _folderIndex.end()) {
+            iter->second.bloom.markRemoved();
+            persistFolderIndex(child.folder.position, iter->second);
+        }
+    }
 
-            auto dirINode = _diskEntity->fileINodeAt(dirPos);
+    u_int64 FSController::unpackChild(const FSController::ChildRef &child, const std::string &func) {
 
-            assert(dirINode.getType() == INode::Folder);
+        auto iNode = child.inode;
+        iNode.type = INode::FILE_TYPE;
+        iNode.openCounter = 0;
+        iNode.next = UNDEFINED;
 
-            auto dirFolderFile = _diskEntity->fileAt(dirPos);
+        // 先分配独立的节点，再从打包节点中移除记录，最后链接到目录末尾
+        auto data = _diskEntity->readRange(DiskEntity::packedDataPos(child.position, child.inode), iNode.size);
+        auto position = _diskEntity->addFile(iNode, data, child.pack);
+        assert(position != UNDEFINED, func, "磁盘已满！");
 
-            auto lastFilePos = IByteable::fromBytes<u_int64>(dirFolderFile->data);
+        removePacked(child);
 
-            INode headFileINode = _diskEntity->fileINodeAt(lastFilePos);
+        // 打包节点可能已被摘除，重新读取目录的首个子项目
+        FolderRef folder{child.folder.position, child.folder.position == UNDEFINED
+                                                ? _diskEntity->root()
+                                                : _diskEntity->folderHeadAt(child.folder.position)};
+        auto &index = folderIndex(folder);
+        linkChild(folder, index, index.tail, position, iNode.name);
 
-            if (headFileINode.name == fileName) {
+        return position;
+    }
 
-                if (!ignoreFolder) {
-                    assert(headFileINode.getType() == INode::UserFile, "FSController::removeFile", "目标项目不为文件2");
-                }
+    bool FSController::packs(u_int64 size) const {
+        auto threshold = _diskEntity->packThreshold();
+        return threshold > 0 && size <= threshold;
+    }
 
-                dirFolderFile->data = IByteable::toBytes(headFileINode.next);
+    std::vector<Extent> FSController::contentOf(u_int64 position, const INode &iNode) const {
+        if (iNode.getType() == INode::Packed) {
+            return {{DiskEntity::packedDataPos(position, iNode), iNode.size}};
+        }
+        return _diskEntity->contentExtents(position);
+    }
 
-                _diskEntity->updateWithoutSizeChange(dirPos, *dirFolderFile);
-                _diskEntity->removeFileAt(lastFilePos);
+    void FSController::setPackThreshold(u_int64 threshold) {
+        assert(role == INode::Admin, "FSController::setPackThreshold", "需要管理员身份");
+        assert(threshold <= MAX_PACK_THRESHOLD, "FSController::setPackThreshold",
+               "打包阈值不能超过 " + std::to_string(MAX_PACK_THRESHOLD) + " 字节");
+        _diskEntity->setPackThreshold(threshold);
+    }
 
-                return;
-            }
+    u_int64 FSController::packThreshold() const {
+        return _diskEntity->packThreshold();
+    }
 
-            u_int64 thisFilePos = headFileINode.next;
+    void FSController::rebasePaths(const std::list<std::string> &oldPath, const std::list<std::string> &newPath) {
+        auto rebase = [&](std::list<std::string> &path) {
+            if (!isUnder(path, oldPath)) return;
+            auto rest = std::list<std::string>(std::next(path.begin(), (long) oldPath.size()), path.end());
+            path = newPath;
+            path.splice(path.end(), rest);
+        };
 
-            INode thisFileINode;
+        for (auto &it: _handles) {
+            rebase(it.second.path);
+        }
+        rebase(_workDir.path);
+    }
 
-            while (thisFilePos != UNDEFINED) {
-                thisFileINode = _diskEntity->fileINodeAt(thisFilePos);
-                if (thisFileINode.name == fileName) break;
+    void FSController::unlinkChild(const FSController::FolderRef &folder, u_int64 lastPos, u_int64 position,
+                                   const INode &iNode) {
 
-                lastFilePos = thisFilePos;
-                thisFilePos = thisFileINode.next;
-            }
+        if (lastPos != UNDEFINED) {
+            _diskEntity->updateNextAt(lastPos, iNode.next);
+        } else if (folder.position == UNDEFINED) {
+            _diskEntity->setRoot(iNode.next);
+        } else {
+            _diskEntity->updateFolderHeadAt(folder.position, iNode.next);
+        }
 
-            assert(thisFilePos != UNDEFINED, "FSController::removeFile", "目标文件不存在");
-            if (!ignoreFolder) {
-                assert(thisFileINode.getType() == INode::UserFile, "FSController::removeFile", "目标项目不为文件3");
-            }
+        auto iter = _folderIndex.find(folder.position);
 
-            _diskEntity->updateNextAt(lastFilePos, thisFileINode.next);
-            _diskEntity->removeFileAt(thisFilePos);
+        if (iter != _folderIndex.end()) {
+            auto &index = iter->second;
+            index.bloom.markRemoved();
+            if (index.tail == position) index.tail = lastPos;
+            persistFolderIndex(folder.position, index);
+        }
 
-            return;
+        if (iNode.getType() == INode::Folder) {
+            _folderIndex.erase(position);
         }
     }
 
@@ -418,45 +1385,123 @@ namespace FileSystem {
 
         assert(!folderPath.empty(), "FSController::removeDir", "无法删除根目录");
 
-        auto folderPos = getFilePos(folderPath);
+        INode inode;
+        auto folderPos = getFilePos(folderPath, &inode);
 
         assert(folderPos != UNDEFINED, "FSController::removeDir");
 
-        auto inode = _diskEntity->fileINodeAt(folderPos);
-
         assert(inode.assertPermission(INode::Edit, role), "FSController::removeDir", "没有足够的权限");
 
-        if (inode.getType() == INode::UserFile) {
-            removeFile(_folderPath, os);
-        } else {
-            removeDirRecursion(IByteable::fromBytes<u_int64>(_diskEntity->fileAt(folderPos)->data), _folderPath, os);
-            removeFile(_folderPath, true, os);
+        if (inode.isFile()) {
+            removeFile(_folderPath, false, os);
+            return;
+        }
+
+        // 一次遍历收集整棵子树的节点位置，先完成全部检查，再统一释放
+        std::vector<u_int64> positions{};
+        std::vector<std::string> removed{};
+
+        collectTree(_diskEntity->folderHeadAt(folderPos), pathStr(_folderPath, false), positions,
+                    os != nullptr ? &removed : nullptr);
+
+        auto position = detachChild(folderPath, true);
+        positions.push_back(position);
+
+        for (auto it: positions) {
+            invalidateHandles(it);
+            _folderIndex.erase(it);
+        }
+
+        if (_lazyDelete) {
+            // 检查已全部通过，摘除的子树交由回收线程释放
+            _reclaimer.submit(position);
+
+            if (os != nullptr) {
+                *os << "删除： " << pathStr(_folderPath, false) << "（后台回收）" << endl;
+            }
+            return;
+        }
+
+        _diskEntity->removeFilesAt(std::move(positions));
+
+        if (os != nullptr) {
+            for (const auto &it: removed) {
+                *os << "删除： " << it << endl;
+            }
+            *os << "删除： " << pathStr(_folderPath, false) << endl;
         }
     }
 
-    void FSController::removeDirRecursion(u_int64 headPosition, const std::list<std::string> &_folderPath,
-                                          std::ostream *os) {
+    void FSController::collectTree(u_int64 headPosition, const std::string &folderPath,
+                                   std::vector<u_int64> &positions, std::vector<std::string> *names, bool checked) {
         std::vector<std::pair<u_int64, INode>> subs{};
 
         while (headPosition != UNDEFINED) {
             auto inode = _diskEntity->fileINodeAt(headPosition);
+
+            if (inode.getType() == INode::Pack) {
+                // 打包节点整体释放，其中的各个小文件只需检查权限
+                for (auto &it: _diskEntity->packedAt(headPosition)) {
+                    assert(!checked || it.inode.assertPermission(INode::Edit, role), "FSController::removeDir",
+                           "没有足够的权限：" + folderPath + "/" + it.inode.name);
+                    if (names != nullptr) names->push_back(folderPath + "/" + it.inode.name);
+                }
+                positions.push_back(headPosition);
+                headPosition = inode.next;
+                continue;
+            }
+
+            assert(!checked || inode.assertPermission(INode::Edit, role), "FSController::removeDir",
+                   "没有足够的权限：" + folderPath + "/" + inode.name);
+
+            assert(!checked || !_leases.isHeld(headPosition), "FSController::removeDir",
+                   "该文件正在被其他用户使用：" + folderPath + "/" + inode.name);
+
             subs.emplace_back(headPosition, inode);
             headPosition = inode.next;
         }
 
-        for (const auto &it: subs) {
-            if (it.second.getType() == INode::Folder) {
-                auto folderPath = _folderPath;
-                folderPath.push_back(it.second.name);
-                removeDirRecursion(IByteable::fromBytes<u_int64>(_diskEntity->fileAt(it.first)->data), folderPath, os);
+        for (auto &sub: std::ranges::reverse_view(subs)) {
+            auto subPath = folderPath + "/" + sub.second.name;
+
+            if (sub.second.getType() == INode::Folder) {
+                collectTree(_diskEntity->folderHeadAt(sub.first), subPath, positions, names, checked);
             }
+
+            positions.push_back(sub.first);
+            if (names != nullptr) names->push_back(subPath);
         }
+    }
 
-        for (auto &sub: std::ranges::reverse_view(subs)) {
-            auto filePath = _folderPath;
-            filePath.push_back(sub.second.name);
-            removeFile(filePath, true, os);
+    void FSController::discardEntry(const std::list<std::string> &folderPath, const std::string &name) {
+
+        if (findChild(resolveFolder(folderPath), name) == UNDEFINED) return;
+
+        auto path = folderPath;
+        path.push_back(name);
+
+        auto child = locateChild(path, "FSController::discardEntry");
+
+        if (child.pack != UNDEFINED) {
+            removePacked(child);
+            return;
+        }
+
+        std::vector<u_int64> positions{};
+
+        if (child.inode.getType() == INode::Folder) {
+            collectTree(_diskEntity->folderHeadAt(child.position), pathStr(path, false), positions, nullptr, false);
+        }
+
+        unlinkChild(child.folder, child.lastPos, child.position, child.inode);
+        positions.push_back(child.position);
+
+        for (auto position: positions) {
+            invalidateHandles(position);
+            _folderIndex.erase(position);
         }
+
+        _diskEntity->removeFilesAt(std::move(positions));
     }
 
     void FSController::changeRole(INode::Role targetRole, const std::string &password) {
@@ -471,19 +1516,27 @@ namespace FileSystem {
 
         assertLogin();
 
-        u_int64 filePos;
-
-        try {
-            filePos = getFilePos(filePath);
-        } catch (Error &) {
-            this->createFile(filePath, ByteArray(), INode::OpenPermission);
-            filePos = getFilePos(filePath);
+        auto folderPath = fixPath(filePath);
+        assert(!folderPath.empty(), "FSController::editFile", "路径非法");
+        auto fileName = folderPath.back();
+        folderPath.pop_back();
+
+        INode packed;
+        if (findChild(resolveFolder(folderPath), fileName, &packed) != UNDEFINED &&
+            packed.getType() == INode::Packed) {
+            // 编辑需要独立的文件节点，打包文件先解包
+            assert(packed.assertPermission(INode::Edit, role), "FSController::editFile", "没有足够的权限");
+            unpackChild(locateChild(fixPath(filePath), "FSController::editFile"), "FSController::editFile");
         }
 
-        FileNode *targetFile = _diskEntity->fileAt(filePos);
+        // 文件不存在时自动创建
+        u_int64 filePos = createOrOpen(folderPath, fileName, ByteArray(), INode::OpenPermission);
+
+        // 克隆文件编辑完成后由 updateFile 重新创建为独立文件，共享数据不受影响
+        FileNode *targetFile = _diskEntity->contentAt(filePos);
 
         assert(
-                targetFile->inode.getType() == INode::UserFile,
+                targetFile->inode.isFile(),
                 "FSController::editFile",
                 "目标项目不为文件"
         );
@@ -495,30 +1548,36 @@ namespace FileSystem {
         );
 
         assert(
-                !targetFile->inode.isEditing(),
+                _leases.acquireExclusive(filePos),
                 "FSController::editFile",
-                "该文件正在被其他用户写"
+                "该文件正在被其他用户使用"
         );
 
-        targetFile->inode.openCounter = 1;
+        if (_persistLeases) {
+            _diskEntity->recordLeaseAt(filePos, true);
+        }
 
-        _diskEntity->updateWithoutSizeChange(filePos, *targetFile);
+        // 文件数据移入编辑会话，不再复制
+        auto fileData = std::move(targetFile->data);
+        auto iNode = std::move(targetFile->inode);
+        delete targetFile;
 
         return {
-                targetFile->data,
-                targetFile->inode,
+                std::move(fileData),
+                std::move(iNode),
                 filePath,
                 [this](
                         const auto &_0,
                         const auto &_1,
-                        const auto &_2
+                        const auto &_2,
+                        const auto &_3
                 ) -> bool {
                     try {
-                        auto res = updateFile(_0, _1, _2);
-                        releaseWriteLock(_2);
+                        auto res = writeBack(_0, _1, _2, _3);
+                        releaseWriteLock(_3);
                         return res;
                     } catch (Error &e) {
-                        releaseWriteLock(_2);
+                        releaseWriteLock(_3);
                         throw e;
                     }
                 },
@@ -549,15 +1608,82 @@ namespace FileSystem {
     bool
     FSController::updateFile(const ByteArray &newData, const INode &oldINode, const std::list<std::string> &oldPath) {
         assertLogin();
+
+        // 文件会被重新分配位置，租约随之迁移；租约与句柄需要稳定的节点位置，新文件不存入打包节点
+        auto lease = _leases.detach(getFilePos(oldPath));
         removeFile(oldPath);
-        return createFile(oldPath, newData, oldINode.permission) != UNDEFINED;
+
+        auto folderPath = fixPath(oldPath);
+        auto fileName = folderPath.back();
+        folderPath.pop_back();
+
+        auto newPos = insertChild(
+                folderPath,
+                INode{fileName, newData.size(), oldINode.permission, INode::FILE_TYPE, 0, UNDEFINED},
+                newData,
+                false,
+                "FSController::updateFile"
+        ).position;
+
+        assert(newPos != UNDEFINED, "FSController::updateFile", "磁盘已满！");
+
+        _leases.attach(newPos, lease);
+
+        return newPos != UNDEFINED;
+    }
+
+    bool FSController::writeBack(const ByteArray &newData, const ByteArray &oldData, const INode &oldINode,
+                                 const std::list<std::string> &oldPath) {
+        assertLogin();
+
+        auto position = getFilePos(oldPath);
+        auto inode = _diskEntity->fileINodeAt(position);
+
+        // 克隆文件需要写时复制；新内容超出节点容量时只能重新分配
+        if (inode.getType() != INode::UserFile || inode.size != oldData.size() ||
+            newData.size() > _diskEntity->capacityAt(position)) {
+            return updateFile(newData, oldINode, oldPath);
+        }
+
+        auto dataPos = _diskEntity->dataPos(position);
+        auto newSize = newData.size();
+
+        auto blockChanged = [&](u_int64 offset) {
+            auto end = std::min(offset + DELTA_BLOCK_SIZE, newSize);
+            return end > oldData.size() ||
+                   std::memcmp(newData.data() + offset, oldData.data() + offset, end - offset) != 0;
+        };
+
+        // 相邻的变化块合并为一次写入
+        for (u_int64 offset = 0; offset < newSize;) {
+            if (!blockChanged(offset)) {
+                offset += DELTA_BLOCK_SIZE;
+                continue;
+            }
+
+            auto end = offset;
+            while (end < newSize && blockChanged(end)) end += DELTA_BLOCK_SIZE;
+            end = std::min(end, newSize);
+
+            _diskEntity->writeRange(dataPos + offset, ByteArray(newData.data() + offset, end - offset));
+            offset = end;
+        }
+
+        if (newSize != inode.size) {
+            _diskEntity->resizeAt(position, newSize);
+            invalidateHandles(position);
+        }
+
+        return true;
     }
 
     void FSController::releaseWriteLock(const std::list<std::string> &oldPath) {
         auto filePos = getFilePos(oldPath);
-        auto file = _diskEntity->fileAt(filePos);
-        file->inode.openCounter = 0;
-        _diskEntity->updateWithoutSizeChange(filePos, *file);
+        _leases.releaseExclusive(filePos);
+        // 获取租约后才关闭持久化时，磁盘上的记录同样需要清除
+        if (!_diskEntity->isLegacy()) {
+            _diskEntity->recordLeaseAt(filePos, false);
+        }
     }
 
     void
@@ -565,25 +1691,30 @@ namespace FileSystem {
         assertLogin();
         assert(role == INode::Admin, "FSController::setFilePermission", "需要管理员身份");
 
-        auto filePos = getFilePos(_filePath);
+        INode inode;
+        auto filePos = getFilePos(_filePath, &inode);
 
         assert(filePos != UNDEFINED, "FSController::setFilePermission", "目标文件不存在");
 
-        auto file = _diskEntity->fileAt(filePos);
-
-        file->inode.permission = permissionGroup;
-
-        _diskEntity->updateWithoutSizeChange(filePos, *file);
+        if (inode.getType() == INode::Packed) {
+            _diskEntity->updatePackedPermissionAt(filePos, permissionGroup);
+        } else {
+            _diskEntity->updatePermissionAt(filePos, permissionGroup);
+        }
     }
 
     std::string FSController::getScript(const std::list<std::string> &_filePath) {
         assertLogin();
-        auto filePos = getFilePos(_filePath);
+        INode inode;
+        auto filePos = getFilePos(_filePath, &inode);
         assert(filePos != UNDEFINED, "FSController::getScript", "目标文件不存在");
-        auto file = _diskEntity->fileAt(filePos);
-        assert(file->inode.assertPermission(INode::Execute, role), "FSController::getScript", "没有足够的权限");
+        assert(_leases.acquireShared(filePos), "FSController::getScript", "该文件正在被其他用户写");
+        auto extents = contentOf(filePos, inode);
+        auto data = _diskEntity->readExtents(extents, 0, DiskEntity::extentsSize(extents));
+        _leases.releaseShared(filePos);
+        assert(inode.assertPermission(INode::Execute, role), "FSController::getScript", "没有足够的权限");
 
-        return std::string{reinterpret_cast<char *>(file->data.data()), file->data.flatSize()};
+        return std::string{reinterpret_cast<const char *>(data.data()), data.flatSize()};
     }
 
     std::list<std::string> FSController::getUserMapPath() {
@@ -592,13 +1723,18 @@ namespace FileSystem {
 
     void FSController::format(std::string adminPassword) {
         assert(role == INode::Admin, "FSController::format", "权限不足");
+        _reclaimer.discard();
         _diskEntity->format(adminPassword);
+        _workDir = {};
+        _folderIndex.clear();
         changeRole(INode::Admin, adminPassword);
         createFile(getUserMapPath(), {}, INode::AdminOnlyPermission);
     }
 
     UserTable FSController::getUsers() {
-        return *UserTable::parse(_diskEntity->fileAt(getFilePos(getUserMapPath()))->data);
+        INode inode;
+        auto extents = contentOf(getFilePos(getUserMapPath(), &inode), inode);
+        return *UserTable::parse(_diskEntity->readExtents(extents, 0, DiskEntity::extentsSize(extents)));
     }
 
     bool FSController::setUsers(UserTable users) {
@@ -624,11 +1760,352 @@ namespace FileSystem {
         assert(role == INode::Admin || onlineUser != nullptr, "FSController::assertLogin", "未登录！");
     }
 
-    std::string FSController::cat(const std::list<std::string> &_filePath) {
+    void FSController::cat(const std::list<std::string> &_filePath, std::ostream &os, CatMode mode, u_int64 lines) {
+        assertLogin();
+        INode inode;
+        auto filePos = getFilePos(_filePath, &inode);
+        assert(inode.isFile(), "FSController::cat", "目标项目不为文件");
+        assert(inode.assertPermission(INode::Read, role), "FSController::cat", "没有足够的权限！");
+        assert(_leases.acquireShared(filePos), "FSController::cat", "该文件正在被其他用户写");
+
+        // from 与 size 为文件内容中的逻辑范围，分段文件按段依次读取
+        auto extents = contentOf(filePos, inode);
+        auto size = DiskEntity::extentsSize(extents);
+        u_int64 from = 0;
+
+        try {
+            if (mode == TailLines) {
+                // 从文件末尾向前逐块查找，只输出最后若干行，末尾的换行符不计为一行
+                auto begin = size;
+                auto scanEnd = size;
+
+                if (lines > 0) {
+                    begin = 0;
+
+                    if (size > 0 && _diskEntity->readExtents(extents, size - 1, 1).data()[0] == std::byte{'\n'}) scanEnd--;
+
+                    u_int64 found = 0;
+                    std::vector<char> buf{};
+
+                    while (scanEnd > 0 && found < lines) {
+                        auto chunkStart = scanEnd - std::min(scanEnd, FileLinker::STREAM_CHUNK_SIZE);
+
+                        buf.clear();
+                        _diskEntity->streamExtents(extents, chunkStart, scanEnd - chunkStart,
+                                                   [&](const char *data, u_int64 n) {
+                                                       buf.insert(buf.end(), data, data + n);
+                                                       return true;
+                                                   });
+
+                        for (auto i = buf.size(); i-- > 0;) {
+                            if (buf[i] == '\n' && ++found == lines) {
+                                begin = chunkStart + i + 1;
+                                break;
+                            }
+                        }
+
+                        scanEnd = chunkStart;
+                    }
+                }
+
+                from += begin;
+                size -= begin;
+            }
+
+            if (mode == HeadLines && lines == 0) size = 0;
+
+            u_int64 found = 0;
+
+            _diskEntity->streamExtents(extents, from, size, [&](const char *data, u_int64 n) {
+                if (mode == HeadLines) {
+                    // 输出到第若干个换行符为止，之后的内容不再读取
+                    for (u_int64 i = 0; i < n; i++) {
+                        if (data[i] == '\n' && ++found == lines) {
+                            os.write(data, static_cast<std::streamsize>(i + 1));
+                            return false;
+                        }
+                    }
+                }
+
+                os.write(data, static_cast<std::streamsize>(n));
+                return true;
+            });
+        } catch (Error &e) {
+            _leases.releaseShared(filePos);
+            throw e;
+        }
+
+        _leases.releaseShared(filePos);
+    }
+
+    bool FSController::isLegacyFormat() const {
+        return _diskEntity->isLegacy();
+    }
+
+    void FSController::upgrade() {
+        assert(role == INode::Admin, "FSController::upgrade", "需要管理员身份");
+        assert(_handles.empty() && _leases.list().empty(), "FSController::upgrade", "存在正在使用的文件，无法升级");
+
+        _reclaimer.drain();
+        _diskEntity->upgrade();
+
+        _workDir = {};
+        _folderIndex.clear();
+    }
+
+    bool FSController::splitMetadata() const {
+        return _diskEntity->splitMetadata();
+    }
+
+    bool FSController::compactOffsets() const {
+        return _diskEntity->compactOffsets();
+    }
+
+    bool FSController::alignedData() const {
+        return _diskEntity->alignedData();
+    }
+
+    void FSController::setAlignedData(bool aligned) {
+        assert(role == INode::Admin, "FSController::setAlignedData", "需要管理员身份");
+        _diskEntity->setAlignedData(aligned);
+    }
+
+    bool FSController::directIO() const {
+        return _diskEntity->directIO();
+    }
+
+    void FSController::setDirectIO(bool direct) {
+        // 影响宿主机上其他进程的缓存，仅允许管理员切换
+        assert(role == INode::Admin, "FSController::setDirectIO", "需要管理员身份");
+        _diskEntity->setDirectIO(direct);
+    }
+
+    void FSController::migrateLayout(bool split) {
+        assert(role == INode::Admin, "FSController::migrateLayout", "需要管理员身份");
+        assert(_handles.empty() && _leases.list().empty(), "FSController::migrateLayout",
+               "存在正在使用的文件，无法重建镜像");
+
+        _reclaimer.drain();
+        _diskEntity->migrate(split);
+
+        _workDir = {};
+        _folderIndex.clear();
+    }
+
+    FSController::LayoutStats FSController::getLayoutStats() {
+        LayoutStats res{};
+        std::unordered_set<u_int64> pages{};
+        u_int64 first = MAX_BYTE_SIZE;
+        u_int64 last = 0;
+
+        std::vector<u_int64> heads{_diskEntity->root()};
+
+        while (!heads.empty()) {
+            auto position = heads.back();
+            heads.pop_back();
+
+            for (u_int64 previous = UNDEFINED; position != UNDEFINED;) {
+                auto iNode = _diskEntity->fileINodeAt(position);
+
+                if (previous != UNDEFINED) {
+                    res.siblingPairs++;
+                    res.siblingDistance += position > previous ? position - previous : previous - position;
+                }
+                previous = position;
+
+                // 普通文件的内容与 inode 存放在一起，只计入节点头部
+                u_int64 size = FileNode::headerSizeFor(iNode);
+                if (iNode.getType() != INode::UserFile) size += iNode.size;
+
+                for (auto page = position / LAYOUT_PAGE_SIZE; page <= (position + size - 1) / LAYOUT_PAGE_SIZE; page++) {
+                    pages.insert(page);
+                }
+
+                first = std::min(first, position / LAYOUT_PAGE_SIZE);
+                last = std::max(last, (position + size - 1) / LAYOUT_PAGE_SIZE);
+
+                res.metadataNodes++;
+                res.metadataBytes += size;
+
+                if (iNode.getType() == INode::Folder) heads.push_back(_diskEntity->folderHeadAt(position));
+
+                position = iNode.next;
+            }
+        }
+
+        res.metadataPages = pages.size();
+        res.metadataSpan = res.metadataNodes == 0 ? 0 : last - first + 1;
+        res.totalPages = (_diskEntity->diskSize() + LAYOUT_PAGE_SIZE - 1) / LAYOUT_PAGE_SIZE;
+
+        return res;
+    }
+
+    u_int64 FSController::LayoutStats::averageSiblingDistance() const {
+        return siblingPairs == 0 ? 0 : siblingDistance / siblingPairs;
+    }
+
+    void FSController::setLeasePersistence(bool persist) {
+        assert(role == INode::Admin, "FSController::setLeasePersistence", "需要管理员身份");
+        assert(!persist || !_diskEntity->isLegacy(), "FSController::setLeasePersistence",
+               "旧格式镜像没有扩展头，请先使用 upgrade 升级");
+        _persistLeases = persist;
+    }
+
+    bool FSController::leasePersistence() const {
+        return _persistLeases;
+    }
+
+    std::list<std::pair<INode, LeaseTable::Lease>> FSController::getLeases() {
+        std::list<std::pair<INode, LeaseTable::Lease>> res{};
+        for (const auto &it: _leases.list()) {
+            res.emplace_back(_diskEntity->fileINodeAt(it.first), it.second);
+        }
+        return res;
+    }
+
+    int FSController::open(const std::list<std::string> &_filePath, FSController::OpenMode mode) {
         assertLogin();
-        auto file = _diskEntity->fileAt(getFilePos(_filePath));
-        assert(file->inode.assertPermission(INode::Read, role), "FSController::cat", "没有足够的权限！");
-        return std::string{reinterpret_cast<const char*>(file->data.data()), file->data.size()};
+
+        auto filePath = fixPath(_filePath);
+        INode inode;
+        auto filePos = getFilePos(filePath, &inode);
+
+        assert(inode.isFile(), "FSController::open", "目标项目不为文件");
+
+        bool writable = mode == ReadWrite;
+
+        assert(inode.assertPermission(writable ? INode::Edit : INode::Read, role), "FSController::open",
+               "没有足够的权限！");
+
+        if (inode.getType() == INode::Packed) {
+            // 句柄需要稳定的节点位置，打包文件先解包
+            assert(!_leases.isHeld(filePos), "FSController::open", "该文件正在被其他用户使用");
+            filePos = unpackChild(locateChild(filePath, "FSController::open"), "FSController::open");
+            inode = _diskEntity->fileINodeAt(filePos);
+        }
+
+        if (writable && inode.getType() == INode::Clone) {
+            // 写时复制：以写模式打开克隆文件前先复制出独立的文件
+            assert(!_leases.isHeld(filePos), "FSController::open", "该文件正在被其他用户使用");
+            filePos = detachClone(locateChild(filePath, "FSController::open"));
+            inode = _diskEntity->fileINodeAt(filePos);
+        }
+
+        if (writable) {
+            assert(_leases.acquireExclusive(filePos), "FSController::open", "该文件正在被其他用户使用");
+        } else {
+            assert(_leases.acquireShared(filePos), "FSController::open", "该文件正在被其他用户写");
+        }
+
+        auto extents = _diskEntity->contentExtents(filePos);
+        inode.size = DiskEntity::extentsSize(extents);
+
+        int handle = _nextHandle++;
+        _handles[handle] = FileHandle{filePath, filePos, inode, std::move(extents), 0, writable, false};
+        return handle;
+    }
+
+    ByteArray FSController::read(int handle, u_int64 size) {
+        auto &it = resolveHandle(handle);
+
+        auto readSize = std::min(size, it.inode.size - std::min(it.cursor, it.inode.size));
+        if (readSize == 0) return {};
+
+        auto res = _diskEntity->readExtents(it.extents, it.cursor, readSize);
+        it.cursor += readSize;
+        return res;
+    }
+
+    u_int64 FSController::write(int handle, const ByteArray &data) {
+        auto &it = resolveHandle(handle);
+
+        assert(it.writable, "FSController::write", "句柄未以写模式打开");
+
+        if (it.cursor + data.size() <= it.inode.size) {
+            // 不改变文件大小，原地写入
+            _diskEntity->writeExtents(it.extents, it.cursor, data);
+            it.cursor += data.size();
+            return data.size();
+        }
+
+        // 超出原文件大小，需要重新分配节点，写入后句柄按路径重新解析
+        auto oldData = _diskEntity->readExtents(it.extents, 0, it.inode.size);
+        auto cursor = std::min(it.cursor, it.inode.size);
+        auto newData = oldData.subByte(0, cursor);
+        newData.append(ByteArray(std::vector<std::byte>(it.cursor - cursor).data(), it.cursor - cursor));
+        newData.append(data);
+
+        assert(updateFile(newData, it.inode, it.path), "FSController::write", "磁盘已满！");
+
+        auto &resolved = resolveHandle(handle);
+        resolved.cursor = it.cursor + data.size();
+        return data.size();
+    }
+
+    u_int64 FSController::seek(int handle, u_int64 cursor) {
+        auto &it = resolveHandle(handle);
+        it.cursor = cursor;
+        return it.cursor;
+    }
+
+    void FSController::close(int handle) {
+        auto &it = resolveHandle(handle);
+        if (it.writable) {
+            _leases.releaseExclusive(it.position);
+        } else {
+            _leases.releaseShared(it.position);
+        }
+        _handles.erase(handle);
+    }
+
+    FSController::FileHandle &FSController::resolveHandle(int handle) {
+        auto iter = _handles.find(handle);
+        assert(iter != _handles.end(), "FSController::resolveHandle", "无效的文件句柄");
+
+        auto &it = iter->second;
+        if (it.stale) {
+            it.position = getFilePos(it.path);
+            it.inode = _diskEntity->fileINodeAt(it.position);
+            it.extents = _diskEntity->contentExtents(it.position);
+            it.inode.size = DiskEntity::extentsSize(it.extents);
+            it.stale = false;
+        }
+        return it;
+    }
+
+    void FSController::setLazyDelete(bool lazy) {
+        // 延迟删除只把释放推迟到回收线程，权限与租约检查照常进行；开关影响所有用户，仅允许管理员修改
+        assert(role == INode::Admin, "FSController::setLazyDelete", "需要管理员身份");
+        if (lazy) _reclaimer.start();
+        _lazyDelete = lazy;
+    }
+
+    bool FSController::lazyDelete() const {
+        return _lazyDelete;
+    }
+
+    Reclaimer::Status FSController::reclaimStatus() const {
+        return _reclaimer.status();
+    }
+
+    void FSController::flushReclaim() {
+        _reclaimer.drain();
+    }
+
+    void FSController::onReclaimed(const std::vector<u_int64> &positions) {
+        for (auto position: positions) {
+            invalidateHandles(position);
+            _folderIndex.erase(position);
+        }
+    }
+
+    void FSController::invalidateHandles(u_int64 position) {
+        for (auto &it: _handles) {
+            if (it.second.position == position) it.second.stale = true;
+        }
+        if (_workDir.position == position) {
+            _workDir = {};
+        }
     }
 
 } // FileSystem
\ No newline at end of file
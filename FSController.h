@@ -5,8 +5,14 @@
 #ifndef FILESYSTEM_FSCONTROLLER_H
 #define FILESYSTEM_FSCONTROLLER_H
 
+#include <mutex>
+#include <unordered_map>
+
 #include "DiskEntity.h"
 #include "UserTable.h"
+#include "LeaseTable.h"
+#include "BloomFilter.h"
+#include "Reclaimer.h"
 
 namespace FileSystem {
 
@@ -22,11 +28,12 @@ namespace FileSystem {
                     ByteArray fileData,
                     INode oldINode,
                     std::list<std::string> oldPath,
-                    std::function<bool(const ByteArray &, INode oldINode, std::list<std::string> oldPath)> onFinish,
+                    std::function<bool(const ByteArray &, const ByteArray &oldData, INode oldINode,
+                                       std::list<std::string> oldPath)> onFinish,
                     std::function<void(std::list<std::string> oldPath)> onCancel
             );
 
-            ByteArray getFileData();
+            [[nodiscard]] const ByteArray &getFileData() const;
 
             std::string getFileName();
 
@@ -36,7 +43,8 @@ namespace FileSystem {
 
         private:
 
-            std::function<bool(const ByteArray &, INode oldINode, std::list<std::string> oldPath)> _onFinish;
+            std::function<bool(const ByteArray &, const ByteArray &oldData, INode oldINode,
+                               std::list<std::string> oldPath)> _onFinish;
             std::function<void(std::list<std::string> oldPath)> _onCancel;
             ByteArray _fileData;
             INode _oldINode;
@@ -44,9 +52,49 @@ namespace FileSystem {
 
         };
 
+        /**
+         * 打开的文件句柄
+         *
+         * 缓存文件节点位置、inode 与数据所在的各段范围，重复读写时无需再次从根目录解析路径。
+         * 文件被重新分配位置后句柄会被标记为失效，下一次使用时按路径重新解析。
+         */
+        struct FileHandle {
+            std::list<std::string> path;
+            u_int64 position;
+            INode inode;
+            std::vector<Extent> extents;
+            u_int64 cursor;
+            bool writable;
+            bool stale;
+        };
+
+        /**
+         * 目录句柄
+         *
+         * 记录文件夹的规范化路径与节点位置，根目录的节点位置为 UNDEFINED。
+         */
+        struct DirHandle {
+            std::list<std::string> path{};
+            u_int64 position{UNDEFINED};
+        };
+
+        enum OpenMode {
+            ReadOnly, ReadWrite
+        };
+
+        FSController() = default;
+
+        ~FSController();
+
         [[nodiscard]] bool good() const;
 
-        void create(u_int64 size, std::string path, const std::string &root_password);
+        /**
+         * 磁盘锁：开启延迟删除后回收线程会在后台修改磁盘，调用者需在每次操作期间持有该锁
+         */
+        [[nodiscard]] std::unique_lock<std::recursive_mutex> lock() const;
+
+        // compact 为 true 时创建紧凑格式（4 字节偏移）的镜像，镜像不能超过 4GB
+        void create(u_int64 size, std::string path, const std::string &root_password, bool compact = false);
 
         void setPath(std::string path);
 
@@ -61,7 +109,14 @@ namespace FileSystem {
         u_int64
         createFile(const std::list<std::string> &_filePath, const ByteArray &data, INode::PermissionGroup permission);
 
-        std::list<INode> getDir(const std::list<std::string> &filePath);
+        u_int64 uploadFile(const std::string &hostPath, const std::list<std::string> &_folderPath, std::string fileName,
+                           INode::PermissionGroup permission = INode::OpenPermission);
+
+        u_int64 createOrOpen(const std::list<std::string> &_folderPath, std::string fileName, const ByteArray &data,
+                             INode::PermissionGroup permission = INode::OpenPermission, bool *created = nullptr);
+
+        // withSize 为 false 时不读取克隆与分段文件的内容节点，只访问元数据，项目大小为目录项本身的大小
+        std::list<INode> getDir(const std::list<std::string> &filePath, bool withSize = true);
 
         INode getINodeByPath(const std::list<std::string> &folderPath);
 
@@ -73,10 +128,49 @@ namespace FileSystem {
 
         void removeDir(const std::list<std::string> &folderPath, std::ostream *os = nullptr);
 
+        void move(const std::list<std::string> &_srcPath, const std::list<std::string> &_dstPath);
+
+        struct CopyResult {
+            u_int64 files{};
+            u_int64 folders{};
+            u_int64 bytes{};
+        };
+
+        // 子树中的文件数不少于该值时并行搬运数据
+        constexpr static std::size_t PARALLEL_COPY_MIN_FILES = 16;
+        constexpr static unsigned int MAX_COPY_WORKERS = 4;
+
+        CopyResult copy(const std::list<std::string> &_srcPath, const std::list<std::string> &_dstPath,
+                        bool recursive = false);
+
+        /**
+         * 导入外部目录树：先统计所需空间并分配、链接全部节点，再由多个线程并行读入文件数据
+         */
+        CopyResult importTree(const std::string &hostDir, const std::list<std::string> &_dstPath);
+
+        /**
+         * 导出子树到外部目录：先遍历并创建全部外部目录，再由多个线程直接从镜像复制文件数据
+         */
+        CopyResult exportTree(const std::list<std::string> &_srcPath, const std::string &hostDir);
+
+        /**
+         * 克隆文件：新目录项与源文件共享同一份数据，任意一方以写模式打开时再复制（写时复制）
+         */
+        void clone(const std::list<std::string> &_srcPath, const std::list<std::string> &_dstPath);
+
         [[nodiscard]] EditSession editFile(const std::list<std::string> &filePath);
 
         bool updateFile(const ByteArray &newData, const INode &oldINode, const std::list<std::string> &oldPath);
 
+        // 增量写回时比较的块大小
+        constexpr static u_int64 DELTA_BLOCK_SIZE = 4096;
+
+        /**
+         * 增量写回：与编辑开始时的内容逐块比较，新内容放得进原节点时只原地写出有变化的块，否则整体替换
+         */
+        bool writeBack(const ByteArray &newData, const ByteArray &oldData, const INode &oldINode,
+                       const std::list<std::string> &oldPath);
+
         void releaseWriteLock(const std::list<std::string> &oldPath);
 
         void setFilePermission(const std::list<std::string> &_filePath, INode::PermissionGroup permissionGroup);
@@ -95,22 +189,267 @@ namespace FileSystem {
 
         bool login(std::string username, std::string password);
 
-        std::string cat(const std::list<std::string> &_filePath);
+        enum CatMode {
+            WholeFile, HeadLines, TailLines
+        };
+
+        /**
+         * 分块输出文件内容，HeadLines / TailLines 只读取前 / 后若干行所在的范围
+         */
+        void cat(const std::list<std::string> &_filePath, std::ostream &os, CatMode mode = WholeFile, u_int64 lines = 0);
 
         void assertLogin();
 
+        [[nodiscard]] bool isLegacyFormat() const;
+
+        void upgrade();
+
+        [[nodiscard]] bool splitMetadata() const;
+
+        [[nodiscard]] bool compactOffsets() const;
+
+        // 切换元数据分离布局，整个镜像按新布局重建
+        void migrateLayout(bool split);
+
+        [[nodiscard]] bool alignedData() const;
+
+        void setAlignedData(bool aligned);
+
+        [[nodiscard]] bool directIO() const;
+
+        void setDirectIO(bool direct);
+
+        void setLeasePersistence(bool persist);
+
+        [[nodiscard]] bool leasePersistence() const;
+
+        std::list<std::pair<INode, LeaseTable::Lease>> getLeases();
+
+        int open(const std::list<std::string> &_filePath, OpenMode mode = ReadOnly);
+
+        ByteArray read(int handle, u_int64 size);
+
+        u_int64 write(int handle, const ByteArray &data);
+
+        u_int64 seek(int handle, u_int64 cursor);
+
+        void close(int handle);
+
+        DirHandle openDir(const std::list<std::string> &_folderPath);
+
+        struct FolderIndexStats {
+            u_int64 folders{};          // 已加载索引的目录数
+            u_int64 bloomBytes{};       // 过滤器位图总字节数
+            u_int64 filtered{};         // 被过滤器直接排除的查询
+            u_int64 falsePositives{};   // 过滤器未能排除、扫描后仍不存在的查询
+        };
+
+        [[nodiscard]] FolderIndexStats getFolderIndexStats() const;
+
+        const static u_int64 LAYOUT_PAGE_SIZE = 4096;
+
+        struct LayoutStats {
+            u_int64 metadataNodes{};    // 目录项、文件夹与打包节点数
+            u_int64 metadataBytes{};    // 元数据（inode、文件夹数据、分段列表与打包记录）字节数
+            u_int64 metadataPages{};    // 元数据分布的页数
+            u_int64 metadataSpan{};     // 首个与最后一个元数据页之间的页数
+            u_int64 totalPages{};       // 镜像总页数
+            u_int64 siblingPairs{};     // 同一目录中相邻项目的对数
+            u_int64 siblingDistance{};  // 相邻同级项目节点之间的距离之和
+
+            [[nodiscard]] u_int64 averageSiblingDistance() const;
+        };
+
+        LayoutStats getLayoutStats();
+
+        void setWorkingDir(const DirHandle &dir);
+
+        [[nodiscard]] const DirHandle &getWorkingDir() const;
+
+        void setLazyDelete(bool lazy);
+
+        [[nodiscard]] bool lazyDelete() const;
+
+        [[nodiscard]] Reclaimer::Status reclaimStatus() const;
+
+        // 新建打包节点时预留的容量，以及打包阈值的上限
+        constexpr static u_int64 PACK_CAPACITY = 4096;
+        constexpr static u_int64 MAX_PACK_THRESHOLD = 1024;
+
+        /**
+         * 小文件打包阈值（保存在镜像的扩展头中）：不超过该大小的新文件作为记录存入所在目录的打包节点，0 表示不打包
+         */
+        void setPackThreshold(u_int64 threshold);
+
+        [[nodiscard]] u_int64 packThreshold() const;
+
+        void flushReclaim();
+
     private:
 
+        /**
+         * 目录引用：文件夹节点位置与首个子项目位置，根目录的节点位置为 UNDEFINED
+         */
+        struct FolderRef {
+            u_int64 position;
+            u_int64 head;
+        };
+
+        /**
+         * 目录索引：子项目链表尾部与名称过滤器
+         * 新格式文件夹持久化于文件夹数据中，根目录与旧格式文件夹只保留在内存中
+         * 查找时重建的索引只改内存，等下一次修改该目录时再写回镜像
+         */
+        struct FolderIndex {
+            u_int64 tail;
+            BloomFilter bloom;
+            bool persistent;
+        };
+
         INode::Role role = INode::Role::User;
 
         UserItem* onlineUser{};
 
-        void
-        removeDirRecursion(u_int64 position, const std::list<std::string> &_folderPath, std::ostream *os = nullptr);
+        // checked 为 false 时不检查权限与租约，用于撤销本次操作刚刚建立的项目
+        void collectTree(u_int64 headPosition, const std::string &folderPath, std::vector<u_int64> &positions,
+                         std::vector<std::string> *names, bool checked = true);
+
+        // 删除本次操作已经建立的项目（包括整棵子树），用于操作中途失败时的回滚；项目不存在时什么也不做
+        void discardEntry(const std::list<std::string> &folderPath, const std::string &name);
+
+        /**
+         * 目录中的一个项目：所在目录、前一个同级项目、自身位置与 inode
+         * 打包文件的位置为其记录在镜像中的位置，pack 为所在的打包节点，lastPos 为打包节点的前一个同级项目
+         */
+        struct ChildRef {
+            FolderRef folder;
+            u_int64 lastPos;
+            u_int64 position;
+            INode inode;
+            u_int64 pack{UNDEFINED};
+        };
+
+        ChildRef locateChild(std::list<std::string> filePath, const std::string &func);
+
+        u_int64 detachChild(std::list<std::string> filePath, bool ignoreFolder);
+
+        void replaceChild(const ChildRef &child, u_int64 position);
+
+        u_int64 detachClone(const ChildRef &child);
+
+        u_int64 findPacked(u_int64 packPos, const std::string &name, INode *iNode) const;
+
+        void removePacked(const ChildRef &child);
+
+        u_int64 unpackChild(const ChildRef &child, const std::string &func);
+
+        [[nodiscard]] bool packs(u_int64 size) const;
+
+        std::vector<Extent> contentOf(u_int64 position, const INode &iNode) const;
+
+        struct InsertResult {
+            u_int64 position;
+            bool created;
+        };
+
+        // packable 为 true 时，不超过打包阈值的文件存入打包节点
+        InsertResult insertChild(const std::list<std::string> &_folderPath, const INode &iNode, const ByteArray &data,
+                                 bool openExisting, const std::string &func, bool packable = false);
+
+        InsertResult insertInto(FolderRef &folder, const INode &iNode, const ByteArray *data, bool openExisting,
+                                const std::string &func, bool packable = false);
+
+        [[nodiscard]] u_int64 getFilePos(const std::list<std::string> &_filePath, INode *iNode = nullptr) const;
+
+        [[nodiscard]] FolderRef resolveFolder(const std::list<std::string> &_folderPath) const;
+
+        u_int64 findChild(const FolderRef &folder, const std::string &name, INode *iNode = nullptr) const;
+
+        FolderIndex &folderIndex(const FolderRef &folder) const;
 
-        [[nodiscard]] u_int64 getFilePos(const std::list<std::string> &_filePath) const;
+        void persistFolderIndex(u_int64 folderPos, FolderIndex &index);
+
+        void unlinkChild(const FolderRef &folder, u_int64 lastPos, u_int64 position, const INode &iNode);
+
+        void linkChild(const FolderRef &folder, FolderIndex &index, u_int64 tailPos, u_int64 position,
+                       const std::string &name);
+
+        void rebasePaths(const std::list<std::string> &oldPath, const std::list<std::string> &newPath);
+
+        void splitTarget(const std::list<std::string> &srcPath, const std::list<std::string> &dstPath,
+                         std::list<std::string> &dstFolderPath, std::string &dstName) const;
+
+        static bool isUnder(const std::list<std::string> &path, const std::list<std::string> &folderPath);
+
+        static ByteArray emptyFolderData();
+
+        // 对齐内容前方长度为 gap 的空闲区域中，因对齐而无法容纳其他节点的部分
+        static u_int64 alignmentGap(u_int64 gap, u_int64 minEmptySize);
+
+        /**
+         * 镜像内复制的一项数据搬运：源数据位置、目标数据位置与字节数
+         */
+        struct CopyJob {
+            u_int64 from;
+            u_int64 to;
+            u_int64 size;
+        };
+
+        // leased 记录已获取共享租约的源文件位置，复制结束后统一释放
+        void copyEntry(u_int64 srcPos, const INode &srcINode, FolderRef &dstFolder, const std::string &name,
+                       std::vector<CopyJob> &jobs, std::vector<u_int64> &leased, CopyResult &result);
+
+        /**
+         * 导入时的一个外部项目：外部路径、名称、大小与子项目在列表中的下标
+         */
+        struct ImportEntry {
+            std::string hostPath;
+            std::string name;
+            u_int64 size;
+            bool folder;
+            std::vector<std::size_t> children;
+        };
+
+        /**
+         * 导出时的一个文件：外部路径与镜像中数据所在的各段范围
+         */
+        struct ExportJob {
+            std::string hostPath;
+            std::vector<Extent> extents;
+        };
+
+        void runParallel(std::size_t count, const std::function<void(std::size_t)> &func);
+
+        FileHandle &resolveHandle(int handle);
+
+        void invalidateHandles(u_int64 position);
+
+        void onReclaimed(const std::vector<u_int64> &positions);
 
         DiskEntity *_diskEntity{nullptr};
+
+        LeaseTable _leases{};
+
+        // 是否将写租约同步写入 inode 的打开计数器（仅作记录，挂载时不会被采信）
+        bool _persistLeases{false};
+
+        std::unordered_map<int, FileHandle> _handles{};
+
+        int _nextHandle{1};
+
+        // 当前工作目录，位于其下的路径从该节点开始解析
+        DirHandle _workDir{};
+
+        mutable std::unordered_map<u_int64, FolderIndex> _folderIndex{};
+
+        mutable FolderIndexStats _folderIndexStats{};
+
+        mutable std::recursive_mutex _diskMutex{};
+
+        // 延迟删除：只摘除目录项，节点交由回收线程在后台释放
+        bool _lazyDelete{false};
+
+        Reclaimer _reclaimer{_diskMutex, [this](const auto &positions) { onReclaimed(positions); }};
     };
 
 } // FileSystem
@@ -8,6 +8,15 @@
 #include <utility>
 #include <filesystem>
 
+#ifdef __linux__
+#include <cerrno>
+#include <cstdlib>
+#include <memory>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
 namespace FileSystem {
 
     FileLinker::FileLinker(std::string _path) : path(std::move(_path)) {}
@@ -60,13 +69,377 @@ namespace FileSystem {
         }
     }
 
-    void FileLinker::write(u_int64 position, u_int64 offset, ByteArray byteArray) const {
+    void FileLinker::write(u_int64 position, u_int64 offset, const ByteArray &byteArray) const {
         doWithFileO(position, offset, [&](std::ofstream &file) {
             file.write(reinterpret_cast<const char *>(byteArray.data()),
                        static_cast<std::streamsize>(byteArray.size()));
         });
     }
 
+    ByteArray FileLinker::read(u_int64 position, u_int64 offset, u_int64 size) const {
+        ByteArray res{};
+        doWithFileI(position, offset, [&](std::ifstream &file) {
+            res.read(file, size, false);
+        });
+        return res;
+    }
+
+    void FileLinker::copy(u_int64 from, u_int64 to, u_int64 size) const {
+        copyTo(*this, from, to, size);
+    }
+
+    void FileLinker::copyTo(const FileLinker &target, u_int64 from, u_int64 to, u_int64 size) const {
+        // 各自打开一个输入流与输出流，以大块缓冲区直接搬运，不经过 ByteArray
+        std::ifstream input{path, std::ios::in | std::ios::binary};
+        std::ofstream output{target.path, std::ios::out | std::ios::in | std::ios::binary};
+
+        if (!input.is_open() || !output.is_open()) {
+            throw Error("FileLinker::copy", "文件打开失败");
+        }
+
+        input.seekg(static_cast<std::streampos>(from), std::ios::beg);
+        output.seekp(static_cast<std::streampos>(to), std::ios::beg);
+
+        pump(input, output, size);
+
+        if (input.fail() || output.fail()) {
+            throw Error("FileLinker::copy", "镜像读写不完整");
+        }
+    }
+
+    void FileLinker::importFrom(const std::string &hostPath, u_int64 to, u_int64 size, u_int64 hostOffset) const {
+
+#ifdef __linux__
+
+        if (_direct && size >= DIRECT_MIN_SIZE) {
+            // 只有对齐的中间部分直接写入，首尾不足一个对齐单位的部分按缓冲方式写入
+            auto head = std::min(size, (DIRECT_ALIGNMENT - to % DIRECT_ALIGNMENT) % DIRECT_ALIGNMENT);
+            auto body = (size - head) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+            auto done = head + importDirect(hostPath, to + head, body, hostOffset + head);
+
+            importBuffered(hostPath, to, head, hostOffset);
+            importBuffered(hostPath, to + done, size - done, hostOffset + done);
+            return;
+        }
+
+#endif
+
+        importBuffered(hostPath, to, size, hostOffset);
+    }
+
+    void FileLinker::importBuffered(const std::string &hostPath, u_int64 to, u_int64 size, u_int64 hostOffset) const {
+        if (size == 0) return;
+
+        // 从外部文件直接写入镜像，不经过 ByteArray
+        std::ifstream input{hostPath, std::ios::in | std::ios::binary};
+        std::ofstream output{path, std::ios::out | std::ios::in | std::ios::binary};
+
+        if (!input.is_open()) {
+            throw Error("FileLinker::importFrom", "外部文件打开失败：" + hostPath);
+        }
+
+        if (!output.is_open()) {
+            throw Error("FileLinker::importFrom", "文件打开失败");
+        }
+
+        input.seekg(static_cast<std::streampos>(hostOffset), std::ios::beg);
+        output.seekp(static_cast<std::streampos>(to), std::ios::beg);
+
+        pump(input, output, size);
+
+        if (input.fail()) {
+            throw Error("FileLinker::importFrom", "外部文件读取不完整：" + hostPath);
+        }
+    }
+
+    void FileLinker::exportTo(u_int64 from, u_int64 size, const std::string &hostPath, u_int64 hostOffset) const {
+
+#ifdef __linux__
+
+        if (_direct && size >= DIRECT_MIN_SIZE) {
+            int output = ::open(hostPath.c_str(), O_WRONLY | O_CREAT | (hostOffset == 0 ? O_TRUNC : 0), 0644);
+
+            if (output < 0) {
+                throw Error("FileLinker::exportTo", "文件打开失败：" + hostPath);
+            }
+
+            bool stopped = false;
+            u_int64 written = 0;
+
+            readDirect(from, size, COPY_CHUNK_SIZE, [&](const char *data, u_int64 n) {
+                for (u_int64 done = 0; done < n;) {
+                    auto res = ::pwrite(output, data + done, n - done, static_cast<off_t>(hostOffset + written));
+                    if (res <= 0) return false;
+                    done += res;
+                    written += res;
+                }
+                return true;
+            }, stopped);
+
+            ::close(output);
+
+            if (stopped) {
+                throw Error("FileLinker::exportTo", "写入外部文件失败：" + hostPath);
+            }
+
+            if (written == size) return;
+
+            from += written;
+            size -= written;
+            hostOffset += written;
+        }
+
+#endif
+
+        exportBuffered(from, size, hostPath, hostOffset);
+    }
+
+    void FileLinker::exportBuffered(u_int64 from, u_int64 size, const std::string &hostPath, u_int64 hostOffset) const {
+
+#ifdef __linux__
+
+        // 在内核中直接从镜像复制到外部文件，不经过用户态缓冲区
+        int input = ::open(path.c_str(), O_RDONLY);
+        int output = ::open(hostPath.c_str(), O_WRONLY | O_CREAT | (hostOffset == 0 ? O_TRUNC : 0), 0644);
+
+        if (input >= 0 && output >= 0 && ::lseek(output, static_cast<off_t>(hostOffset), SEEK_SET) < 0) {
+            ::close(output);
+            output = -1;
+        }
+
+        if (input < 0 || output < 0) {
+            if (input >= 0) ::close(input);
+            if (output >= 0) ::close(output);
+            throw Error("FileLinker::exportTo", "文件打开失败：" + hostPath);
+        }
+
+        auto offset = static_cast<off_t>(from);
+        bool rangeCopy = true;
+
+        while (size > 0) {
+            ssize_t copied;
+
+            if (rangeCopy) {
+                copied = ::copy_file_range(input, &offset, output, nullptr, size, 0);
+
+                // 内核或文件系统不支持时改用 sendfile
+                if (copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                    rangeCopy = false;
+                    continue;
+                }
+            } else {
+                copied = ::sendfile(output, input, &offset, size);
+            }
+
+            if (copied <= 0) break;
+
+            size -= copied;
+        }
+
+        ::close(input);
+        ::close(output);
+
+        if (size > 0) {
+            throw Error("FileLinker::exportTo", "写入外部文件失败：" + hostPath);
+        }
+
+#else
+
+        std::ifstream input{path, std::ios::in | std::ios::binary};
+        auto mode = std::ios::out | std::ios::binary | (hostOffset == 0 ? std::ios::trunc : std::ios::in);
+        std::ofstream output{hostPath, mode};
+
+        if (!input.is_open() || !output.is_open()) {
+            throw Error("FileLinker::exportTo", "文件打开失败：" + hostPath);
+        }
+
+        input.seekg(static_cast<std::streampos>(from), std::ios::beg);
+        output.seekp(static_cast<std::streampos>(hostOffset), std::ios::beg);
+
+        pump(input, output, size);
+
+        if (input.fail()) {
+            throw Error("FileLinker::exportTo", "镜像读取不完整");
+        }
+
+#endif
+    }
+
+    void FileLinker::stream(u_int64 from, u_int64 size, const std::function<bool(const char *, u_int64)> &f) const {
+#ifdef __linux__
+
+        if (_direct && size >= DIRECT_MIN_SIZE) {
+            bool stopped = false;
+            auto done = readDirect(from, size, STREAM_CHUNK_SIZE, f, stopped);
+
+            if (stopped) return;
+
+            from += done;
+            size -= done;
+        }
+
+#endif
+
+        // 以固定大小的缓冲区逐块读取，回调返回 false 时提前结束
+        std::ifstream input{path, std::ios::in | std::ios::binary};
+
+        if (!input.is_open()) {
+            throw Error("FileLinker::stream", "文件打开失败");
+        }
+
+        input.seekg(static_cast<std::streampos>(from), std::ios::beg);
+
+        std::vector<char> buf(std::min(size, STREAM_CHUNK_SIZE));
+
+        while (size > 0) {
+            auto chunk = std::min(size, (u_int64) buf.size());
+            input.read(buf.data(), static_cast<std::streamsize>(chunk));
+
+            // 镜像被截断时不能把缓冲区中残留的内容当作文件数据交给回调
+            if (input.gcount() != static_cast<std::streamsize>(chunk)) {
+                throw Error("FileLinker::stream", "镜像读取不完整");
+            }
+
+            if (!f(buf.data(), chunk)) return;
+            size -= chunk;
+        }
+    }
+
+#ifdef __linux__
+
+    namespace {
+        // 直接 I/O 要求缓冲区地址按 DIRECT_ALIGNMENT 对齐
+        std::unique_ptr<char, decltype(&std::free)> alignedBuffer(u_int64 size) {
+            void *buf = nullptr;
+            if (::posix_memalign(&buf, FileLinker::DIRECT_ALIGNMENT, size) != 0) throw std::bad_alloc();
+            return {static_cast<char *>(buf), &std::free};
+        }
+    }
+
+    u_int64 FileLinker::importDirect(const std::string &hostPath, u_int64 to, u_int64 size, u_int64 hostOffset) const {
+        if (size == 0) return 0;
+
+        int output = ::open(path.c_str(), O_WRONLY | O_DIRECT);
+
+        if (output < 0) return 0;
+
+        int input = ::open(hostPath.c_str(), O_RDONLY);
+
+        if (input < 0) {
+            ::close(output);
+            throw Error("FileLinker::importFrom", "外部文件打开失败：" + hostPath);
+        }
+
+        auto buf = alignedBuffer(std::min(size, COPY_CHUNK_SIZE));
+        u_int64 done = 0;
+        bool complete = true;
+
+        while (done < size) {
+            auto chunk = std::min(size - done, COPY_CHUNK_SIZE);
+
+            for (u_int64 got = 0; got < chunk;) {
+                auto res = ::pread(input, buf.get() + got, chunk - got, static_cast<off_t>(hostOffset + done + got));
+                if (res <= 0) {
+                    complete = false;
+                    break;
+                }
+                got += res;
+            }
+
+            if (!complete) break;
+
+            // 写入失败或只写入了一部分时停止，剩余部分按缓冲方式写入
+            auto res = ::pwrite(output, buf.get(), chunk, static_cast<off_t>(to + done));
+            if (res > 0) done += res;
+            if (res != static_cast<ssize_t>(chunk)) break;
+        }
+
+        // 外部文件已读取的部分不再需要缓存
+        ::posix_fadvise(input, static_cast<off_t>(hostOffset), static_cast<off_t>(done), POSIX_FADV_DONTNEED);
+
+        ::close(input);
+        ::close(output);
+
+        if (!complete) {
+            throw Error("FileLinker::importFrom", "外部文件读取不完整：" + hostPath);
+        }
+
+        return done;
+    }
+
+    u_int64 FileLinker::readDirect(u_int64 from, u_int64 size, u_int64 chunkSize,
+                                   const std::function<bool(const char *, u_int64)> &f, bool &stopped) const {
+        int input = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+
+        if (input < 0) return 0;
+
+        // 读取范围向前扩展到对齐边界，chunkSize 为对齐单位的整数倍，每次读取的起点都保持对齐
+        auto pos = from / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+        auto skip = from - pos;
+        auto alignUp = [](u_int64 n) { return (n + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT; };
+        auto buf = alignedBuffer(std::min(alignUp(skip + size), chunkSize));
+        u_int64 done = 0;
+
+        while (done < size && !stopped) {
+            auto want = std::min(alignUp(skip + size - done), chunkSize);
+            auto res = ::pread(input, buf.get(), want, static_cast<off_t>(pos));
+
+            if (res <= static_cast<ssize_t>(skip)) break;
+
+            auto n = std::min(static_cast<u_int64>(res) - skip, size - done);
+            stopped = !f(buf.get() + skip, n);
+            done += n;
+
+            // 读到镜像末尾等情况下没有读满时停止，剩余部分按缓冲方式读取
+            if (res != static_cast<ssize_t>(want)) break;
+
+            pos += want;
+            skip = 0;
+        }
+
+        ::close(input);
+
+        return done;
+    }
+
+#endif
+
+    void FileLinker::setDirect(bool direct) {
+        _direct = direct;
+    }
+
+    bool FileLinker::direct() const {
+        return _direct;
+    }
+
+    void FileLinker::pump(std::istream &input, std::ostream &output, u_int64 size) {
+        std::vector<char> buf(std::min(size, COPY_CHUNK_SIZE));
+
+        while (size > 0) {
+            auto chunk = static_cast<std::streamsize>(std::min(size, (u_int64) buf.size()));
+            input.read(buf.data(), chunk);
+            output.write(buf.data(), chunk);
+            size -= chunk;
+        }
+    }
+
+    ByteArray FileLinker::readHost(const std::string &hostPath, u_int64 size) {
+        std::ifstream input{hostPath, std::ios::in | std::ios::binary};
+
+        if (!input.is_open()) {
+            throw Error("FileLinker::readHost", "外部文件打开失败：" + hostPath);
+        }
+
+        ByteArray res{};
+        res.read(input, size, false);
+
+        if (input.fail()) {
+            throw Error("FileLinker::readHost", "外部文件读取不完整：" + hostPath);
+        }
+
+        return res;
+    }
+
     std::ifstream *FileLinker::getFileInput(u_int64 position, u_int64 offset) const {
         auto *file = new std::ifstream{path, std::ios::in};
         if (file->is_open()) {
@@ -78,18 +451,18 @@ namespace FileSystem {
 
     template<class T>
     T FileLinker::readAt(u_int64 position, u_int64 offset) {
-        char *data = static_cast<char *>(malloc(sizeof(T)));
+        T res{};
         doWithFileI(position, offset, [&](std::ifstream &file) {
-            file.read(data, sizeof(T));
+            file.read(reinterpret_cast<char *>(&res), sizeof(T));
         });
-        T *res = static_cast<T *>(malloc(sizeof(T)));
-        std::memcpy(res, data, sizeof(T));
-        return *res;
+        return res;
     }
 
     template int FileLinker::readAt(u_int64 position, u_int64 offset);
 
     template u_int64 FileLinker::readAt(u_int64 position, u_int64 offset);
 
+    template unsigned char FileLinker::readAt(u_int64 position, u_int64 offset);
+
     FileLinker::~FileLinker() = default;
 } // FileSystem
\ No newline at end of file
@@ -29,7 +29,45 @@ namespace FileSystem {
 
         void doWithFileO(u_int64 position, u_int64 offset, const std::function<void(std::ofstream &)> &f) const;
 
-        void write(u_int64 position, u_int64 offset, ByteArray byteArray) const;
+        void write(u_int64 position, u_int64 offset, const ByteArray &byteArray) const;
+
+        [[nodiscard]] ByteArray read(u_int64 position, u_int64 offset, u_int64 size) const;
+
+        void copy(u_int64 from, u_int64 to, u_int64 size) const;
+
+        // 复制到另一个镜像文件中，同样分块搬运
+        void copyTo(const FileLinker &target, u_int64 from, u_int64 to, u_int64 size) const;
+
+        // hostOffset 为外部文件中的起始位置，分段文件按段依次读写同一个外部文件
+        void importFrom(const std::string &hostPath, u_int64 to, u_int64 size, u_int64 hostOffset = 0) const;
+
+        // hostOffset 为 0 时截断外部文件，否则写入其中的指定位置
+        void exportTo(u_int64 from, u_int64 size, const std::string &hostPath, u_int64 hostOffset = 0) const;
+
+        void stream(u_int64 from, u_int64 size, const std::function<bool(const char *, u_int64)> &f) const;
+
+        // 镜像内复制时每次读写的块大小
+        constexpr static u_int64 COPY_CHUNK_SIZE = 1 << 20;
+
+        // 分块输出文件内容时每次读取的块大小
+        constexpr static u_int64 STREAM_CHUNK_SIZE = 1 << 16;
+
+        /**
+         * 直接 I/O：开启后，不小于 DIRECT_MIN_SIZE 的导入、导出与分块读取绕过页缓存读写镜像，
+         * 避免大文件的传输挤出缓存中的元数据。镜像中按 DIRECT_ALIGNMENT 对齐的部分经由对齐的缓冲区直接读写，
+         * 写入时首尾不对齐的部分、较小的读写以及不支持直接 I/O 的文件系统仍使用普通的缓冲读写
+         */
+        constexpr static u_int64 DIRECT_ALIGNMENT = 4096;
+        constexpr static u_int64 DIRECT_MIN_SIZE = 1 << 20;
+
+        void setDirect(bool direct);
+
+        [[nodiscard]] bool direct() const;
+
+        static void pump(std::istream &input, std::ostream &output, u_int64 size);
+
+        // 将外部小文件整体读入内存
+        static ByteArray readHost(const std::string &hostPath, u_int64 size);
 
         template<class T>
         T readAt(u_int64 position, u_int64 offset);
@@ -38,6 +76,20 @@ namespace FileSystem {
 
         // private:
         std::string path;
+
+    private:
+
+        void importBuffered(const std::string &hostPath, u_int64 to, u_int64 size, u_int64 hostOffset) const;
+
+        void exportBuffered(u_int64 from, u_int64 size, const std::string &hostPath, u_int64 hostOffset) const;
+
+        // 以下返回已直接读写的字节数，文件系统不支持直接 I/O 时为 0，剩余部分由调用者以缓冲方式完成
+        u_int64 importDirect(const std::string &hostPath, u_int64 to, u_int64 size, u_int64 hostOffset) const;
+
+        u_int64 readDirect(u_int64 from, u_int64 size, u_int64 chunkSize,
+                           const std::function<bool(const char *, u_int64)> &f, bool &stopped) const;
+
+        bool _direct{false};
     };
 
 } // FileSystem
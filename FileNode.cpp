@@ -10,12 +10,19 @@
 namespace FileSystem {
 
 
-    INode *INode::parse(std::istream &istream) {
+    INode *INode::parse(std::istream &istream, bool withHash, bool compact) {
 
         auto *res = new INode();
 
+        res->withHash = withHash;
+        res->compact = compact;
+
         auto nameSize = IByteable::fromBytes<std::byte>(ByteArray().read(istream, 1, false));
 
+        if (withHash) {
+            ByteArray().read(istream, HASH_SIZE, false);
+        }
+
         res->name = std::string{
                 reinterpret_cast<const char *>(
                         ByteArray()
@@ -25,7 +32,7 @@ namespace FileSystem {
                 static_cast<unsigned char>(nameSize)
         };
 
-        res->size = IByteable::fromBytes<u_int64>(ByteArray().read(istream, 8, false));
+        res->size = res->layout().readOffset(istream);
 
         res->permission = PermissionGroup::fromByte(*(ByteArray().read(istream, 1, false).data()));
 
@@ -33,7 +40,7 @@ namespace FileSystem {
 
         res->openCounter = IByteable::fromBytes<int>(ByteArray().read(istream, 4, false));
 
-        res->next = IByteable::fromBytes<u_int64>(ByteArray().read(istream, 8, false));
+        res->next = res->layout().readOffset(istream);
 
         return res;
     }
@@ -44,13 +51,44 @@ namespace FileSystem {
                 return UserFile;
             case 1:
                 return Folder;
+            case 2:
+                return SharedData;
+            case 3:
+                return Clone;
+            case 4:
+                return Extents;
+            case 5:
+                return ExtentData;
+            case 6:
+                return Pack;
+            case 7:
+                return Packed;
             default:
                 return Unknown;
         }
     }
 
+    bool INode::isFile() const {
+        auto res = getType();
+        return res == UserFile || res == Clone || res == Extents || res == Packed;
+    }
+
     u_int64 INode::getSize() const {
-        return name.size() + 23;
+        return 1 + (withHash ? HASH_SIZE : 0) + name.size() + layout().fixedSize;
+    }
+
+    const NodeLayout &INode::layout() const {
+        return NodeLayout::of(compact);
+    }
+
+    unsigned int INode::hashName(const std::string &name) {
+        // FNV-1a 32 位
+        unsigned int hash = 0x811c9dc5;
+        for (unsigned char ch: name) {
+            hash ^= ch;
+            hash *= 0x01000193;
+        }
+        return hash;
     }
 
     std::string INode::typeStr(INode::Type type) {
@@ -62,6 +100,24 @@ namespace FileSystem {
             case Folder:
                 res = "Folder";
                 break;
+            case SharedData:
+                res = "SharedData";
+                break;
+            case Clone:
+                res = "Clone";
+                break;
+            case Extents:
+                res = "Extents";
+                break;
+            case ExtentData:
+                res = "ExtentData";
+                break;
+            case Pack:
+                res = "Pack";
+                break;
+            case Packed:
+                res = "Packed";
+                break;
             case Unknown:
                 res = "Unknown";
                 break;
@@ -118,30 +174,44 @@ namespace FileSystem {
 
     u_int64 FileNode::mainSize() const {
         assert(data.size() == inode.size, "FileNode::mainSize");
-        return FileNode::INODE_START + inode.getSize() + FileNode::EXPANSION_OCC + inode.size + expansionSize;
+        return sizeFor(inode, expansionSize);
     }
 
-    ByteArray FileNode::toBytes() {
-        auto res = ByteArray()
+    u_int64 FileNode::sizeFor(const INode &iNode, u_int64 expansionSize) {
+        return headerSizeFor(iNode) + iNode.size + expansionSize;
+    }
+
+    u_int64 FileNode::headerSizeFor(const INode &iNode) {
+        return iNode.layout().inodeStart + iNode.getSize() + iNode.layout().expansionOcc;
+    }
+
+    ByteArray FileNode::headerBytes() {
+        return ByteArray()
                 .append(reinterpret_cast<const std::byte *>("FILE"), 4)
-                .append(IByteable::toBytes(lastNode))
-                .append(IByteable::toBytes(nextNode))
+                .append(inode.layout().offsetBytes(lastNode))
+                .append(inode.layout().offsetBytes(nextNode))
                 .append(inode.toBytes())
-                .append(IByteable::toBytes(expansionSize))
-                .append(data);
+                .append(inode.layout().offsetBytes(expansionSize));
+    }
+
+    ByteArray FileNode::toBytes() {
+        auto res = headerBytes().append(data);
         assert(res.size() + expansionSize == mainSize(), "FileNode::data");
         return res;
     }
 
-    FileNode *FileNode::parse(std::istream &input) {
-        auto from = input.tellg();
+    FileNode *FileNode::parse(std::istream &input, bool withHash, bool withData, bool compact) {
+        auto &layout = NodeLayout::of(compact);
         ByteArray().read(input, 4, false);
-        auto _1 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _2 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _3 = *INode::parse(input);
-        auto _4 = IByteable::fromBytes<u_int64>(ByteArray().read(input, 8, false));
-        auto _5 = ByteArray().read(input, _3.size, false);
-        return new FileNode(_1, _2, _3, _4, _5);
+        auto _1 = layout.readOffset(input);
+        auto _2 = layout.readOffset(input);
+        auto _3 = INode::parse(input, withHash, compact);
+        auto _4 = layout.readOffset(input);
+        ByteArray _5{};
+        if (withData) _5.read(input, _3->size, false);
+        auto res = new FileNode(_1, _2, std::move(*_3), _4, std::move(_5));
+        delete _3;
+        return res;
     }
 
     void FileNode::setExpansionSize(u_int64 size) {
@@ -167,6 +237,14 @@ namespace FileSystem {
 
         if (type == INode::Folder) {
             ss << "FolderHead: " << IByteable::fromBytes<u_int64>(data) << endl;
+        } else if (type == INode::Clone) {
+            ss << "Shared: " << IByteable::fromBytes<u_int64>(data) << endl;
+        } else if (type == INode::SharedData) {
+            ss << "RefCount: " << std::dec << inode.openCounter << std::hex << endl;
+        } else if (type == INode::Extents) {
+            ss << "Extents: " << std::dec << inode.size / sizeof(u_int64) << std::hex << endl;
+        } else if (type == INode::Pack) {
+            ss << "Capacity: " << inode.size + expansionSize << endl;
         }
 
         ss << std::dec;
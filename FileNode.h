@@ -9,6 +9,7 @@
 #include <string>
 #include <utility>
 #include "Utils.h"
+#include "NodeLayout.h"
 
 namespace FileSystem {
 
@@ -18,6 +19,7 @@ namespace FileSystem {
      * 存储格式： | 文件标识 4 字节 | 上一节点位置 8 字节 | 下一节点位置 8 字节 | iode 索引节点 n| 系统需要强制扩容大小 8 字节 | 数据 |
      * inode：
      *      文件名称长度         1 字节
+     *      文件名称哈希         4 字节（旧格式镜像中不存在）
      *      文件名称            动态，最多 255 字节
      *      文件大小            8 字节
      *      权限信息            1 字节
@@ -25,6 +27,8 @@ namespace FileSystem {
      *      文件打开计数器       4 字节
      *      下一个同级文件地址    8 字节
      *
+     * 紧凑格式的镜像中，以上 8 字节的字段均为 4 字节，各字段偏移见 NodeLayout
+     *
      * 运行时额外标识（用户内存）
      *      文件指针
      *      文件位置
@@ -38,6 +42,14 @@ namespace FileSystem {
 
         const static std::byte FILE_TYPE = std::byte{0};
         const static std::byte FOLDER_TYPE = std::byte{1};
+        const static std::byte SHARED_TYPE = std::byte{2};
+        const static std::byte CLONE_TYPE = std::byte{3};
+        const static std::byte EXTENTS_TYPE = std::byte{4};
+        const static std::byte EXTENT_DATA_TYPE = std::byte{5};
+        const static std::byte PACK_TYPE = std::byte{6};
+        const static std::byte PACKED_TYPE = std::byte{7};
+
+        const static u_int64 HASH_SIZE = 4;
 
         enum PermissionType {
             Read, Edit, Execute
@@ -71,20 +83,42 @@ namespace FileSystem {
                 {false, false, false}
         };
 
+        /**
+         * 克隆文件：目录项 Clone 的数据为 8 字节的共享数据节点位置，
+         * 共享数据节点 SharedData 不属于任何目录，保存文件内容，其打开计数器用作引用计数。
+         * 任意一方被修改时先复制出独立的文件（写时复制）。
+         *
+         * 分段文件：没有足够大的连续空闲区域时，目录项 Extents 的数据为按顺序排列的各段节点位置（每个 8 字节），
+         * 分段节点 ExtentData 不属于任何目录，名称为空，数据为文件内容的一段。
+         *
+         * 打包文件：小文件不单独占用节点，而是作为一条记录存放在所在目录的打包节点 Pack 中（名称为空，位于同级链表中），
+         * Packed 只用于内存中表示其中的一条记录，不会出现在磁盘上的 inode 中。
+         */
         enum Type {
             Unknown = -1,
             UserFile = 0,
             Folder = 1,
+            SharedData = 2,
+            Clone = 3,
+            Extents = 4,
+            ExtentData = 5,
+            Pack = 6,
+            Packed = 7,
         };
 
         static std::string typeStr(Type type);
 
         [[nodiscard]] u_int64 getSize() const;
 
-        static INode *parse(std::istream &istream);
+        static INode *parse(std::istream &istream, bool withHash = true, bool compact = false);
+
+        static unsigned int hashName(const std::string &name);
 
         [[nodiscard]] Type getType() const;
 
+        // 是否可以作为文件读写（普通文件、克隆文件、分段文件或打包文件）
+        [[nodiscard]] bool isFile() const;
+
         bool assertPermission(PermissionType _type, Role _role);
 
         std::string name{};
@@ -95,6 +129,15 @@ namespace FileSystem {
         int openCounter{};
         u_int64 next{};
 
+        // 是否以带名称哈希的格式存储
+        bool withHash{true};
+
+        // 是否以紧凑格式（4 字节的大小与位置字段）存储
+        bool compact{false};
+
+        // 定长字段相对于文件名称结束处（名称长度 1 字节 + 名称哈希 4 字节 + 名称 n 字节之后）的偏移
+        [[nodiscard]] const NodeLayout &layout() const;
+
         bool isEditing() const;
 
         INode() = default;
@@ -114,13 +157,18 @@ namespace FileSystem {
 
             assert(nameSize <= 0xff);
 
-            auto bytes = ByteArray(static_cast<std::byte>((unsigned char) nameSize))
-                    .append(reinterpret_cast<const std::byte *>(name.c_str()), nameSize)
-                    .append(IByteable::toBytes(size))
+            auto bytes = ByteArray(static_cast<std::byte>((unsigned char) nameSize));
+
+            if (withHash) {
+                bytes.append(IByteable::toBytes(hashName(name)));
+            }
+
+            bytes.append(reinterpret_cast<const std::byte *>(name.c_str()), nameSize)
+                    .append(layout().offsetBytes(size))
                     .append(permission.toByte())
                     .append(type)
                     .append(IByteable::toBytes(openCounter))
-                    .append(IByteable::toBytes(next));
+                    .append(layout().offsetBytes(next));
 
             return bytes;
         }
@@ -131,17 +179,23 @@ namespace FileSystem {
     class FileNode : IByteable {
     public:
 
-        static const u_int64 INODE_START = 20;
-        static const u_int64 EXPANSION_OCC = 8;
-
         // 创建新文件
         FileNode(u_int64 lastNode, u_int64 nextNode, INode iNode, u_int64 expansionSize, ByteArray data);
 
         ByteArray toBytes() override;
 
+        // 节点数据之前的部分：标识、前后节点位置、inode 与扩容大小
+        ByteArray headerBytes();
+
         u_int64 mainSize() const;
 
-        static FileNode *parse(std::istream &input);
+        static u_int64 sizeFor(const INode &iNode, u_int64 expansionSize = 0);
+
+        // withData 为 false 时只解析节点头部，data 为空
+        static FileNode *parse(std::istream &input, bool withHash = true, bool withData = true, bool compact = false);
+
+        // 节点数据之前的部分的大小
+        static u_int64 headerSizeFor(const INode &iNode);
 
         void setExpansionSize(u_int64 size);
 
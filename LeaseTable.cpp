@@ -0,0 +1,84 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#include "LeaseTable.h"
+
+namespace FileSystem {
+
+    bool LeaseTable::acquireShared(u_int64 position) {
+        std::lock_guard<std::mutex> guard{_mutex};
+        auto &lease = _leases[position];
+        if (lease.writer) {
+            eraseIfFree(position);
+            return false;
+        }
+        lease.readers++;
+        return true;
+    }
+
+    void LeaseTable::releaseShared(u_int64 position) {
+        std::lock_guard<std::mutex> guard{_mutex};
+        auto it = _leases.find(position);
+        if (it == _leases.end()) return;
+        if (it->second.readers > 0) it->second.readers--;
+        eraseIfFree(position);
+    }
+
+    bool LeaseTable::acquireExclusive(u_int64 position) {
+        std::lock_guard<std::mutex> guard{_mutex};
+        auto &lease = _leases[position];
+        if (lease.writer || lease.readers > 0) {
+            eraseIfFree(position);
+            return false;
+        }
+        lease.writer = true;
+        return true;
+    }
+
+    void LeaseTable::releaseExclusive(u_int64 position) {
+        std::lock_guard<std::mutex> guard{_mutex};
+        auto it = _leases.find(position);
+        if (it == _leases.end()) return;
+        it->second.writer = false;
+        eraseIfFree(position);
+    }
+
+    bool LeaseTable::isHeld(u_int64 position) const {
+        std::lock_guard<std::mutex> guard{_mutex};
+        return _leases.contains(position);
+    }
+
+    LeaseTable::Lease LeaseTable::detach(u_int64 position) {
+        std::lock_guard<std::mutex> guard{_mutex};
+        auto it = _leases.find(position);
+        if (it == _leases.end()) return {};
+        auto lease = it->second;
+        _leases.erase(it);
+        return lease;
+    }
+
+    void LeaseTable::attach(u_int64 position, LeaseTable::Lease lease) {
+        if (!lease.writer && lease.readers == 0) return;
+        std::lock_guard<std::mutex> guard{_mutex};
+        _leases[position] = lease;
+    }
+
+    std::list<std::pair<u_int64, LeaseTable::Lease>> LeaseTable::list() const {
+        std::lock_guard<std::mutex> guard{_mutex};
+        return {_leases.begin(), _leases.end()};
+    }
+
+    void LeaseTable::clear() {
+        std::lock_guard<std::mutex> guard{_mutex};
+        _leases.clear();
+    }
+
+    void LeaseTable::eraseIfFree(u_int64 position) {
+        auto it = _leases.find(position);
+        if (it != _leases.end() && !it->second.writer && it->second.readers == 0) {
+            _leases.erase(it);
+        }
+    }
+
+} // FileSystem
@@ -0,0 +1,59 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#ifndef FILESYSTEM_LEASETABLE_H
+#define FILESYSTEM_LEASETABLE_H
+
+#include <mutex>
+#include <unordered_map>
+
+#include "Utils.h"
+
+namespace FileSystem {
+
+    /**
+     * 文件租约表（仅存在于内存中）
+     *
+     * 以文件节点位置为键，支持多个共享读者与一个独占写者。
+     * 挂载时租约表为空，上一次挂载遗留的租约自然过期。
+     */
+    class LeaseTable {
+
+    public:
+
+        struct Lease {
+            int readers{0};
+            bool writer{false};
+        };
+
+        bool acquireShared(u_int64 position);
+
+        void releaseShared(u_int64 position);
+
+        bool acquireExclusive(u_int64 position);
+
+        void releaseExclusive(u_int64 position);
+
+        [[nodiscard]] bool isHeld(u_int64 position) const;
+
+        Lease detach(u_int64 position);
+
+        void attach(u_int64 position, Lease lease);
+
+        [[nodiscard]] std::list<std::pair<u_int64, Lease>> list() const;
+
+        void clear();
+
+    private:
+
+        void eraseIfFree(u_int64 position);
+
+        std::unordered_map<u_int64, Lease> _leases{};
+
+        mutable std::mutex _mutex{};
+    };
+
+} // FileSystem
+
+#endif //FILESYSTEM_LEASETABLE_H
@@ -0,0 +1,34 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#include "NodeLayout.h"
+
+namespace FileSystem {
+
+    ByteArray NodeLayout::offsetBytes(u_int64 value) const {
+        if (offsetSize == sizeof(unsigned int)) {
+            assert(fits(value), "NodeLayout::offsetBytes", "数值超出紧凑格式的表示范围");
+            return IByteable::toBytes(static_cast<unsigned int>(value));
+        }
+        return IByteable::toBytes(value);
+    }
+
+    u_int64 NodeLayout::offsetFrom(const ByteArray &bytes) const {
+        if (offsetSize == sizeof(unsigned int)) return IByteable::fromBytes<unsigned int>(bytes);
+        return IByteable::fromBytes<u_int64>(bytes);
+    }
+
+    u_int64 NodeLayout::readOffset(std::istream &input) const {
+        return offsetFrom(ByteArray().read(input, offsetSize, false));
+    }
+
+    bool NodeLayout::fits(u_int64 value) const {
+        return offsetSize >= sizeof(u_int64) || value >> (8 * offsetSize) == 0;
+    }
+
+    const NodeLayout &NodeLayout::of(bool compact) {
+        return compact ? COMPACT_LAYOUT : WIDE_LAYOUT;
+    }
+
+} // FileSystem
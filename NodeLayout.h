@@ -0,0 +1,75 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#ifndef FILESYSTEM_NODELAYOUT_H
+#define FILESYSTEM_NODELAYOUT_H
+
+#include "Utils.h"
+
+namespace FileSystem {
+
+    /**
+     * 节点中位置与大小字段（上一/下一节点位置、文件大小、下一个同级文件地址、扩容大小、空闲大小、上一/下一空闲节点）的宽度，
+     * 以及由此确定的各字段偏移
+     *
+     * 默认格式的字段为 8 字节；紧凑格式（FEATURE_COMPACT_OFFSETS，只能在创建小于 4GB 的镜像时选择）为 4 字节，
+     * 节点头部、inode 与空闲节点随之缩小。两种格式共用同一套读写代码，只按镜像的格式选择布局
+     */
+    struct NodeLayout {
+
+        u_int64 offsetSize;
+
+        // 节点头部：| 标识 4 字节 | 上一节点位置 | 下一节点位置 | inode | 扩容大小 | 数据 |
+        u_int64 lastNodeStart;
+        u_int64 nextNodeStart;
+        u_int64 inodeStart;
+        u_int64 expansionOcc;
+
+        // inode 定长字段相对于文件名称结束处的偏移：| 文件大小 | 权限 1 字节 | 类型 1 字节 | 打开计数器 4 字节 | 下一个同级文件地址 |
+        u_int64 sizeOffset;
+        u_int64 permissionOffset;
+        u_int64 typeOffset;
+        u_int64 openCounterOffset;
+        u_int64 nextOffset;
+        u_int64 fixedSize;
+
+        // 空闲节点：| 标识 4 字节 | 上一节点位置 | 下一节点位置 | 空闲大小 | 上一空闲节点 | 下一空闲节点 |，整个节点即最小空闲区域
+        u_int64 lastEmptyStart;
+        u_int64 nextEmptyStart;
+        u_int64 minEmptySize;
+
+        constexpr explicit NodeLayout(u_int64 offsetSize) :
+                offsetSize(offsetSize),
+                lastNodeStart(4),
+                nextNodeStart(4 + offsetSize),
+                inodeStart(4 + 2 * offsetSize),
+                expansionOcc(offsetSize),
+                sizeOffset(0),
+                permissionOffset(offsetSize),
+                typeOffset(offsetSize + 1),
+                openCounterOffset(offsetSize + 2),
+                nextOffset(offsetSize + 6),
+                fixedSize(2 * offsetSize + 6),
+                lastEmptyStart(4 + 3 * offsetSize),
+                nextEmptyStart(4 + 4 * offsetSize),
+                minEmptySize(4 + 5 * offsetSize) {}
+
+        [[nodiscard]] ByteArray offsetBytes(u_int64 value) const;
+
+        [[nodiscard]] u_int64 offsetFrom(const ByteArray &bytes) const;
+
+        [[nodiscard]] u_int64 readOffset(std::istream &input) const;
+
+        // 字段能否表示该值（紧凑格式下镜像大小不能达到 4GB）
+        [[nodiscard]] bool fits(u_int64 value) const;
+
+        static const NodeLayout &of(bool compact);
+    };
+
+    inline constexpr NodeLayout WIDE_LAYOUT{sizeof(u_int64)};
+    inline constexpr NodeLayout COMPACT_LAYOUT{sizeof(unsigned int)};
+
+} // FileSystem
+
+#endif //FILESYSTEM_NODELAYOUT_H
@@ -0,0 +1,166 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#include "Reclaimer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace FileSystem {
+
+    Reclaimer::Reclaimer(std::recursive_mutex &diskMutex, std::function<void(const std::vector<u_int64> &)> onFreed)
+            : _diskMutex(diskMutex), _onFreed(std::move(onFreed)) {}
+
+    Reclaimer::~Reclaimer() {
+        shutdown();
+    }
+
+    void Reclaimer::setDisk(DiskEntity *disk) {
+        std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+        _disk = disk;
+    }
+
+    void Reclaimer::start() {
+        std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+        if (_thread.joinable()) return;
+        _stop = false;
+        _thread = std::thread(&Reclaimer::run, this);
+    }
+
+    void Reclaimer::submit(u_int64 position) {
+        std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+        assert(_thread.joinable(), "Reclaimer::submit", "回收线程未启动");
+        // 子树在扫描前大小未知，先记下根节点本身的大小
+        auto size = _disk->nodeSizeAt(position);
+        _trees.emplace_back(position, size);
+        _status.queuedTrees++;
+        _status.queuedBytes += size;
+        _cv.notify_one();
+    }
+
+    void Reclaimer::drain() {
+        // 在调用者线程中同步完成全部回收，回收线程此时无法获得磁盘锁
+        std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+        while (hasWork()) step();
+    }
+
+    void Reclaimer::discard() {
+        // 磁盘被格式化后，尚未回收的节点位置已无意义
+        std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+        _trees.clear();
+        _scanStack.clear();
+        _ready.clear();
+        _readyIndex = 0;
+        _status = {.freedBytes = _status.freedBytes};
+    }
+
+    void Reclaimer::shutdown() {
+        // 不能在持有磁盘锁时调用：回收线程需要获得磁盘锁才能完成剩余工作并退出
+        {
+            std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+            _stop = true;
+        }
+        _cv.notify_all();
+        if (_thread.joinable()) _thread.join();
+    }
+
+    Reclaimer::Status Reclaimer::status() const {
+        std::lock_guard<std::recursive_mutex> guard{_diskMutex};
+        return _status;
+    }
+
+    void Reclaimer::run() {
+        std::unique_lock<std::recursive_mutex> lock{_diskMutex};
+
+        while (true) {
+            _cv.wait(lock, [this] { return _stop || hasWork(); });
+
+            // 退出前完成剩余工作，避免留下无法访问的节点
+            if (!hasWork()) break;
+
+            step();
+
+            if (!_stop) {
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(THROTTLE_MS));
+                lock.lock();
+            }
+        }
+    }
+
+    bool Reclaimer::hasWork() const {
+        return !_trees.empty() || !_scanStack.empty() || _readyIndex < _ready.size();
+    }
+
+    void Reclaimer::step() {
+
+        if (_scanStack.empty() && _readyIndex < _ready.size()) {
+
+            // 释放一批节点
+            auto end = std::min(_readyIndex + BATCH_NODES, _ready.size());
+
+            std::vector<u_int64> positions{};
+            u_int64 bytes = 0;
+
+            for (auto i = _readyIndex; i < end; i++) {
+                positions.push_back(_ready[i].first);
+                bytes += _ready[i].second;
+            }
+
+            _disk->removeFilesAt(positions);
+            _onFreed(positions);
+
+            _status.pendingNodes -= positions.size();
+            _status.pendingBytes -= bytes;
+            _status.freedBytes += bytes;
+
+            _readyIndex = end;
+
+            if (_readyIndex == _ready.size()) {
+                _ready.clear();
+                _readyIndex = 0;
+            }
+
+            return;
+        }
+
+        if (_scanStack.empty()) {
+            _scanStack.emplace_back(_trees.front().first, false);
+            _status.queuedTrees--;
+            _status.queuedBytes -= _trees.front().second;
+            _trees.pop_front();
+            _status.scanning = true;
+        }
+
+        // 扫描一批节点
+        for (std::size_t i = 0; i < BATCH_NODES && !_scanStack.empty(); i++) {
+            auto [position, followNext] = _scanStack.back();
+            _scanStack.pop_back();
+
+            auto inode = _disk->fileINodeAt(position);
+
+            if (followNext && inode.next != UNDEFINED) {
+                _scanStack.emplace_back(inode.next, true);
+            }
+
+            if (inode.getType() == INode::Folder) {
+                auto head = _disk->folderHeadAt(position);
+                if (head != UNDEFINED) _scanStack.emplace_back(head, true);
+            }
+
+            auto size = _disk->nodeSizeAt(position);
+
+            _ready.emplace_back(position, size);
+            _status.pendingNodes++;
+            _status.pendingBytes += size;
+        }
+
+        if (_scanStack.empty()) {
+            std::sort(_ready.begin() + (long) _readyIndex, _ready.end());
+            _status.scanning = false;
+        }
+    }
+
+} // FileSystem
@@ -0,0 +1,97 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+#ifndef FILESYSTEM_RECLAIMER_H
+#define FILESYSTEM_RECLAIMER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DiskEntity.h"
+
+namespace FileSystem {
+
+    /**
+     * 后台空间回收器
+     *
+     * 延迟删除时项目只从父目录中摘除，整棵子树交由回收线程处理：
+     * 先分批扫描子树得到全部节点位置，再按地址顺序分批归还空闲链表，每批之间让出磁盘锁。
+     * 尚未释放的节点在磁盘上仍是文件节点，不计入空闲空间。
+     */
+    class Reclaimer {
+
+    public:
+
+        struct Status {
+            u_int64 queuedTrees{};      // 尚未开始扫描的子树
+            u_int64 queuedBytes{};      // 尚未开始扫描的子树根节点的字节数，只是待回收空间的下限
+            u_int64 pendingNodes{};     // 已扫描、尚未释放的节点
+            u_int64 pendingBytes{};     // 已扫描、尚未释放的字节
+            u_int64 freedBytes{};       // 累计已释放的字节
+            bool scanning{};            // 是否正在扫描子树（此时待释放字节仍在增长）
+        };
+
+        // 每批处理的节点数与批次间隔
+        constexpr static std::size_t BATCH_NODES = 256;
+        constexpr static int THROTTLE_MS = 2;
+
+        Reclaimer(std::recursive_mutex &diskMutex, std::function<void(const std::vector<u_int64> &)> onFreed);
+
+        ~Reclaimer();
+
+        void setDisk(DiskEntity *disk);
+
+        void start();
+
+        void submit(u_int64 position);
+
+        void drain();
+
+        void discard();
+
+        void shutdown();
+
+        [[nodiscard]] Status status() const;
+
+    private:
+
+        void run();
+
+        [[nodiscard]] bool hasWork() const;
+
+        void step();
+
+        std::recursive_mutex &_diskMutex;
+
+        std::condition_variable_any _cv{};
+
+        std::thread _thread{};
+
+        bool _stop{false};
+
+        DiskEntity *_disk{nullptr};
+
+        std::function<void(const std::vector<u_int64> &)> _onFreed;
+
+        // 待扫描的子树根节点与提交时记录的根节点大小
+        std::deque<std::pair<u_int64, u_int64>> _trees{};
+
+        // 扫描栈：节点位置与是否继续沿兄弟链表扫描（子树根节点不沿兄弟链表扫描）
+        std::vector<std::pair<u_int64, bool>> _scanStack{};
+
+        // 已扫描的节点位置与大小，扫描结束后按地址排序分批释放
+        std::vector<std::pair<u_int64, u_int64>> _ready{};
+
+        std::size_t _readyIndex{0};
+
+        Status _status{};
+    };
+
+} // FileSystem
+
+#endif //FILESYSTEM_RECLAIMER_H
@@ -5,6 +5,7 @@
 
 #include "Terminal.h"
 
+#include <chrono>
 #include <ranges>
 #include <filesystem>
 #include <bitset>
@@ -28,6 +29,7 @@ namespace FileSystem {
 
         try {
             auto target = router.at(decompose.first);
+            auto guard = controller.lock();
             target(decompose.second);
         } catch (std::out_of_range &) {
             os << "未知命令：" << decompose.first << endl;
@@ -102,18 +104,20 @@ namespace FileSystem {
         router["create"] = [this](const auto &args) { create(args); };
         docs["create"] = {
                 "创建一个新的文件系统",
-                "create [文件系统创建路径] [文件系统大小] [管理员密码]\n"
+                "create [文件系统创建路径] [文件系统大小] [管理员密码] {可选：-compact}\n"
                 "使用这个命令来创建一个新的文件系统\n"
                 "你可以像这样使用该命令 \"create D:/myFileSystem.sfs 512MB abc123\"\n"
                 "文件系统至少需要 8KB 大小才能工作\n"
+                "-compact 使用紧凑格式：节点中的位置与大小字段为 4 字节，元数据更小，镜像不能超过 4GB\n"
                 "创建完成后终端将自动连接该文件系统"
         };
 
         router["ls"] = [this](const auto &args) { ls(args); };
         docs["ls"] = {
                 "显示目录下的项目",
-                "ls {可选：目录名}\n"
-                "显示目标目录下的项目"
+                "ls {可选：-R} {可选：目录名}\n"
+                "显示目标目录下的项目\n"
+                "-R 依次显示目标目录及其全部子目录下的项目"
         };
 
         router["mkdir"] = [this](const auto &args) { mkdir(args); };
@@ -150,7 +154,7 @@ namespace FileSystem {
         docs["upload"] = {
                 "从外部上传文件",
                 "upload [外部文件地址] {可选: 文件路径 / 文件名}\n"
-                "从外部上传文件"
+                "从外部上传文件，按文件大小预留节点后分块直接写入，内存占用与文件大小无关，结束时报告写入速度"
         };
 
         router["rm"] = [this](const auto &args) { rm(args); };
@@ -164,7 +168,7 @@ namespace FileSystem {
         docs["struct"] = {
                 "打印磁盘结构",
                 "struct\n"
-                "输出磁盘结构"
+                "输出磁盘结构，末尾给出同一目录中相邻项目节点之间的平均距离"
         };
 
         router["clear"] = [](const auto &args) { clear(args); };
@@ -181,6 +185,47 @@ namespace FileSystem {
                 "删除目录"
         };
 
+        router["mv"] = [this](const auto &args) { mv(args); };
+        docs["mv"] = {
+                "移动或重命名",
+                "mv [源路径] [目标路径]\n"
+                "目标为已存在的文件夹时移入其中，否则移动并重命名为目标路径的最后一段\n"
+                "只修改目录项，不复制文件数据；名称长度改变时新建一个目录项指向原有的数据节点"
+        };
+
+        router["cp"] = [this](const auto &args) { cp(args); };
+        docs["cp"] = {
+                "在镜像内复制",
+                "cp {可选：-r} [源路径] [目标路径]\n"
+                "目标为已存在的文件夹时复制到其中，否则复制并命名为目标路径的最后一段\n"
+                "-r 复制整个文件夹，文件较多时由多个线程并行搬运数据"
+        };
+
+        router["import"] = [this](const auto &args) { importDir(args); };
+        docs["import"] = {
+                "导入外部目录树",
+                "import [外部目录] {可选: 目标路径}\n"
+                "目标为已存在的文件夹时导入到其中，否则导入并命名为目标路径的最后一段；省略时导入到当前目录\n"
+                "先统计所需空间，一次性分配并链接全部节点，再由多个线程并行读入文件数据"
+        };
+
+        router["export"] = [this](const auto &args) { exportDir(args); };
+        docs["export"] = {
+                "导出子树到外部目录",
+                "export [路径] [外部目录]\n"
+                "外部目录已存在时导出到其中，否则以其为导出后的路径；路径为根目录时导出全部内容\n"
+                "先遍历子树并创建全部外部目录，再由多个线程直接从镜像复制文件数据"
+        };
+
+        router["clone"] = [this](const auto &args) { clone(args); };
+        docs["clone"] = {
+                "克隆文件（写时复制）",
+                "clone [源路径] [目标路径]\n"
+                "新文件与源文件共享同一份数据，不复制内容\n"
+                "任意一方被修改时才复制出独立的文件，其余克隆不受影响\n"
+                "源文件尚不是克隆时会被原地转为共享数据，因此需要源文件的编辑权限"
+        };
+
         router["edit"] = [this](const auto &args) { edit(args); };
         docs["edit"] = {
                 "编辑文件，文件不存在自动创建",
@@ -253,8 +298,74 @@ namespace FileSystem {
         router["cat"] = [this](const auto &args) { cat(args); };
         docs["cat"] = {
                 "输出文件内容",
-                "cat [文件路径]\n"
-                "保持硬盘大小不变，格式化硬盘。"
+                "cat {可选: -head 行数 / -tail 行数} [文件路径]\n"
+                "从镜像中分块读取并输出文件内容，不会一次性读入整个文件\n"
+                "-head 只输出前若干行，-tail 只输出最后若干行，只读取所需的范围"
+        };
+
+        router["lease"] = [this](const auto &args) { lease(args); };
+        docs["lease"] = {
+                "查看文件租约",
+                "lease {可选：persist [on / off]}\n"
+                "列出当前被读写占用的文件\n"
+                "persist on（管理员）时写租约同时记录到磁盘，设置只在本次连接中有效\n"
+                "重新挂载镜像时，上次遗留在磁盘上的租约记录全部清除"
+        };
+
+        router["upgrade"] = [this](const auto &args) { upgrade(args); };
+        docs["upgrade"] = {
+                "升级旧格式镜像（管理员）",
+                "upgrade\n"
+                "将旧格式镜像重建为当前格式（在 inode 中存储名称哈希等）\n"
+                "升级期间需要与原镜像相同大小的临时空间"
+        };
+
+        router["reclaim"] = [this](const auto &args) { reclaim(args); };
+        docs["reclaim"] = {
+                "查看或设置后台空间回收",
+                "reclaim {可选：status / flush / lazy [on / off]}\n"
+                "status 查看待回收的字节数（待回收的空间尚未计入空闲空间）；尚未扫描的子树只计入根节点，显示为下限\n"
+                "flush 立即完成全部待回收的工作\n"
+                "lazy on 开启延迟删除（管理员）：rm / rmdir 检查通过后只摘除目录项，节点由后台线程分批释放\n"
+                "重新挂载镜像后延迟删除恢复为关闭"
+        };
+
+        router["pack"] = [this](const auto &args) { pack(args); };
+        docs["pack"] = {
+                "查看或设置小文件打包阈值",
+                "pack {可选：阈值 如 512B / off}\n"
+                "设置阈值（管理员）后，不超过阈值的新文件存放在所在目录的打包节点中，不再单独占用节点\n"
+                "打包文件被 open / edit / mv / clone 时先解包为独立的文件；off 关闭打包，已打包的文件不受影响\n"
+                "阈值保存在镜像中，旧格式镜像需要先 upgrade"
+        };
+
+        router["layout"] = [this](const auto &args) { layout(args); };
+        docs["layout"] = {
+                "查看或切换元数据分离布局",
+                "layout {可选：split / mixed / align [on / off]}\n"
+                "显示目录项等元数据在镜像中的分布情况\n"
+                "align on 开启内容对齐（管理员）：不小于 4KB 的文件内容从 4KB 对齐的位置开始，只影响之后写入的文件\n"
+                "对齐留出的空间可在 struct 的末尾查看\n"
+                "split 切换为元数据分离布局（管理员）：文件内容从镜像末尾分配，目录项集中在镜像开头\n"
+                "mixed 切换回 inode 与内容相邻存放的布局\n"
+                "切换时按新布局重建整个镜像，需要与原镜像相同大小的临时空间"
+        };
+
+        router["io"] = [this](const auto &args) { io(args); };
+        docs["io"] = {
+                "查看或切换直接 I/O",
+                "io {可选：direct [on / off]}\n"
+                "direct on 开启直接 I/O（管理员）：不小于 1MB 的 import / export / cat 绕过宿主机的页缓存读写镜像，\n"
+                "避免大文件传输挤出缓存中的元数据；首尾不对齐的部分与较小的读写仍经过缓存\n"
+                "开启内容对齐（layout align on）后大文件的内容从对齐位置开始，几乎全部可以直接读写\n"
+                "设置只在本次连接中有效"
+        };
+
+        router["stats"] = [this](const auto &args) { stats(args); };
+        docs["stats"] = {
+                "查看运行统计",
+                "stats\n"
+                "输出目录名称过滤器的误判率与每个目录占用的字节数"
         };
 
 
@@ -329,27 +440,39 @@ namespace FileSystem {
         controller.setPath(pathHolder);
         os << "链接成功！" << endl;
 
+        if (controller.isLegacyFormat()) {
+            os << "该镜像为旧格式，可使用 upgrade 命令升级以加快目录查找。" << endl;
+        }
+
         resetUrl();
     }
 
     void Terminal::create(const std::list<std::string> &args) {
 
-        assertArgSize(args, {3}, "create");
+        auto argSize = assertArgSize(args, {3, 4}, "create");
 
         auto iter = args.begin();
         std::string pathHolder = *(iter++);
         std::string sizeStr = *(iter++);
-        std::string rootPassword = *iter;
+        std::string rootPassword = *(iter++);
+
+        assert(argSize == 3 || *iter == "-compact", "Terminal::create", "未知参数：" + args.back());
+
+        u_int64 size;
 
         try {
-            u_int64 size = parseSizeString(sizeStr);
-            controller.create(size, pathHolder, rootPassword);
-            os << "创建成功！" << endl;
+            size = parseSizeString(sizeStr);
         } catch (size_format_error &) {
 
+            throw Error{"Terminal::create", "非法的大小输入: " + sizeStr};
+        } catch (std::exception &) {
+
             throw Error{"Terminal::create", "非法的大小输入: " + sizeStr};
         }
 
+        controller.create(size, pathHolder, rootPassword, argSize == 4);
+        os << "创建成功！" << endl;
+
         resetUrl();
     }
 
@@ -359,27 +482,44 @@ namespace FileSystem {
 
         std::list<std::string> target;
 
-        auto argSize = assertArgSize(args, {0, 1}, "ls");
+        auto argSize = assertArgSize(args, {0, 1, 2}, "ls");
 
-        if (argSize == 1) {
-            target = parseUrl(args.front());
+        bool recursive = argSize > 0 && args.front() == "-R";
+
+        assertLazy(argSize < 2 || recursive, "Terminal::ls", [&] { return "未知参数：" + args.front(); });
+
+        if (argSize == (recursive ? 2 : 1)) {
+            target = parseUrl(args.back());
         } else {
             target = sessionUrl;
         }
 
-        auto targetStr = pathStr(target);
+        // 只输出名称，不读取文件内容所在的节点
+        std::list<std::list<std::string>> pending{target};
 
-        auto dirs = controller.getDir(target);
-        if (dirs.empty()) {
-            os << "目录 " + targetStr + " 下为空" << endl;
-        } else {
-            os << "目录 " + targetStr + " 下共有 " + std::to_string(dirs.size()) + " 个项目" << endl;
-            for (const auto &inode: dirs) {
-                os << inode.name;
-                if (inode.getType() == INode::Folder) {
-                    os << '/';
+        while (!pending.empty()) {
+            auto folder = std::move(pending.front());
+            pending.pop_front();
+
+            auto targetStr = pathStr(folder);
+
+            auto dirs = controller.getDir(folder, false);
+            if (dirs.empty()) {
+                os << "目录 " + targetStr + " 下为空" << endl;
+            } else {
+                os << "目录 " + targetStr + " 下共有 " + std::to_string(dirs.size()) + " 个项目" << endl;
+                for (const auto &inode: dirs) {
+                    os << inode.name;
+                    if (inode.getType() == INode::Folder) {
+                        os << '/';
+                        if (recursive) {
+                            auto child = folder;
+                            child.push_back(inode.name);
+                            pending.push_back(std::move(child));
+                        }
+                    }
+                    os << endl;
                 }
-                os << endl;
             }
         }
     }
@@ -403,15 +543,11 @@ namespace FileSystem {
         assertConnection();
         assertArgSize(args, {1}, "cd");
 
-        auto targetPath = parseUrl(args.front());
+        // 保存当前目录的句柄，之后位于其下的路径直接从该节点开始解析
+        auto dir = controller.openDir(parseUrl(args.front()));
+        controller.setWorkingDir(dir);
+        sessionUrl = dir.path;
 
-        if (targetPath.empty()) {
-            sessionUrl.clear();
-        } else {
-            auto inode = controller.getINodeByPath(targetPath);
-            assert(inode.getType() == INode::Folder, "Terminal::cd", "目标项目不是文件夹");
-            sessionUrl = fixPath(targetPath);
-        }
         os << "已到达路径：" << getUrl() << endl;
     }
 
@@ -496,15 +632,17 @@ namespace FileSystem {
             targetPath.pop_back();
         }
 
-        auto fSize = std::filesystem::file_size(args.front());
+        auto start = std::chrono::steady_clock::now();
 
-        std::ifstream f{args.front(), std::ios::in | std::ios::binary};
+        auto size = controller.uploadFile(args.front(), targetPath, fileName);
 
-        auto data = ByteArray().read(f, fSize, false);
-
-        f.close();
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        controller.createFile(targetPath, fileName, data);
+        os << "上传完成：" << size << " 字节，用时 " << seconds << " 秒";
+        if (seconds > 0) {
+            os << "，" << (double) size / (1 << 20) / seconds << " MB/s";
+        }
+        os << endl;
     }
 
     void Terminal::rm(const std::list<std::string> &args) {
@@ -544,6 +682,76 @@ namespace FileSystem {
         controller.removeDir(targetFileUrl, &os);
     }
 
+    void Terminal::mv(const std::list<std::string> &args) {
+
+        assertConnection();
+
+        assertArgSize(args, {2}, "mv");
+
+        auto srcUrl = parseUrl(args.front());
+
+        controller.move(srcUrl, parseUrl(args.back()));
+
+        // 当前目录位于被移动的文件夹之下时，跟随其新的路径
+        if (sessionUrl.size() >= srcUrl.size() && std::equal(srcUrl.begin(), srcUrl.end(), sessionUrl.begin())) {
+            sessionUrl = controller.getWorkingDir().path;
+        }
+
+        os << "移动成功！" << endl;
+    }
+
+    void Terminal::cp(const std::list<std::string> &args) {
+
+        assertConnection();
+
+        auto argSize = assertArgSize(args, {2, 3}, "cp");
+
+        if (argSize == 3) {
+            assert(args.front() == "-r", "Terminal::cp", "未知参数：" + args.front());
+        }
+
+        auto result = controller.copy(parseUrl(*std::next(args.begin(), argSize - 2)), parseUrl(args.back()),
+                                      argSize == 3);
+
+        os << "复制完成：" << result.files << " 个文件，" << result.folders << " 个文件夹，共 " << result.bytes
+           << " 字节" << endl;
+    }
+
+    void Terminal::importDir(const std::list<std::string> &args) {
+
+        assertConnection();
+
+        auto argSize = assertArgSize(args, {1, 2}, "import");
+
+        auto result = controller.importTree(args.front(), argSize == 2 ? parseUrl(args.back()) : sessionUrl);
+
+        os << "导入完成：" << result.files << " 个文件，" << result.folders << " 个文件夹，共 " << result.bytes
+           << " 字节" << endl;
+    }
+
+    void Terminal::exportDir(const std::list<std::string> &args) {
+
+        assertConnection();
+
+        assertArgSize(args, {2}, "export");
+
+        auto result = controller.exportTree(parseUrl(args.front()), args.back());
+
+        os << "导出完成：" << result.files << " 个文件，" << result.folders << " 个文件夹，共 " << result.bytes
+           << " 字节" << endl;
+    }
+
+    void Terminal::clone(const std::list<std::string> &args) {
+
+        assertConnection();
+
+        assertArgSize(args, {2}, "clone");
+
+        controller.clone(parseUrl(args.front()), parseUrl(args.back()));
+
+        os << "克隆成功！" << endl;
+    }
+
     void Terminal::edit(const std::list<std::string> &args) {
 
         assertConnection();
@@ -574,13 +782,14 @@ namespace FileSystem {
             }
         }
 
-        std::ofstream tempFile{tempFileName, std::ios::out | std::ios::trunc};
+        std::ofstream tempFile{tempFileName, std::ios::out | std::ios::trunc | std::ios::binary};
 
         assert(tempFile.is_open(), "Terminal::edit", "临时文件创建失败");
 
-        auto fileData = editSession->getFileData();
+        const auto &fileData = editSession->getFileData();
 
-        tempFile.write(reinterpret_cast<char *>(fileData.data()), fileData.flatSize());
+        tempFile.write(reinterpret_cast<const char *>(fileData.data()),
+                       static_cast<std::streamsize>(fileData.flatSize()));
 
         tempFile.close();
 
@@ -626,16 +835,17 @@ namespace FileSystem {
 
         auto newFileSize = std::filesystem::file_size(tempFileName);
 
-        char *buf = new char[newFileSize];
+        // 临时文件直接读入 ByteArray，随后按引用一路传递到写入磁盘
+        ByteArray newData{};
 
-        std::ifstream i{tempFileName};
+        std::ifstream i{tempFileName, std::ios::in | std::ios::binary};
 
-        i.read(buf, newFileSize);
+        newData.read(i, newFileSize, false);
 
         i.close();
 
         try {
-            editSession->assignEditFinish(ByteArray(reinterpret_cast<std::byte *>(buf), newFileSize));
+            editSession->assignEditFinish(newData);
         } catch (Error &e) {
             std::filesystem::remove(tempFileName);
             tempFileName = "";
@@ -723,9 +933,174 @@ namespace FileSystem {
 
     void Terminal::cat(const std::list<std::string> &args) {
         assertConnection();
-        assertArgSize(args, {1}, "cat");
-        os << controller.cat(parseUrl(args.front())) << endl;
+        auto argSize = assertArgSize(args, {1, 3}, "cat");
+
+        auto mode = FSController::WholeFile;
+        u_int64 lines = 0;
+
+        if (argSize == 3) {
+            auto &flag = args.front();
+            assert(flag == "-head" || flag == "-tail", "Terminal::cat", "未知参数：" + flag);
+            mode = flag == "-head" ? FSController::HeadLines : FSController::TailLines;
+
+            try {
+                lines = std::stoull(*std::next(args.begin()));
+            } catch (std::exception &) {
+                throw Error("Terminal::cat", "行数必须为非负整数");
+            }
+        }
+
+        controller.cat(parseUrl(args.back()), os, mode, lines);
+        os << endl;
+    }
+
+
+    void Terminal::lease(const std::list<std::string> &args) {
+        assertConnection();
+        auto argSize = assertArgSize(args, {0, 2}, "lease");
+
+        if (argSize == 2) {
+            assert(args.front() == "persist", "Terminal::lease", "首个参数必须为 persist，详见 help lease");
+            assert(args.back() == "on" || args.back() == "off", "Terminal::lease", "第二个参数必须为 on 或 off");
+            controller.setLeasePersistence(args.back() == "on");
+        }
+
+        os << "租约持久化：" << (controller.leasePersistence() ? "开启" : "关闭") << endl;
+
+        auto leases = controller.getLeases();
+        if (leases.empty()) {
+            os << "当前没有被占用的文件" << endl;
+            return;
+        }
+        for (const auto &it: leases) {
+            os << filledStr(it.first.name, HELP_CMD_MAX_LENGTH);
+            if (it.second.writer) {
+                os << "写";
+            } else {
+                os << "读 x" << it.second.readers;
+            }
+            os << endl;
+        }
+    }
+
+    void Terminal::upgrade(const std::list<std::string> &args) {
+        assertConnection();
+        assertArgSize(args, {0}, "upgrade");
+
+        controller.upgrade();
+        os << "升级完成！" << endl;
+
+        resetUrl();
+    }
+
+    void Terminal::reclaim(const std::list<std::string> &args) {
+        assertConnection();
+        auto argSize = assertArgSize(args, {0, 1, 2}, "reclaim");
+
+        if (argSize == 2) {
+            assert(args.front() == "lazy", "Terminal::reclaim", "首个参数必须为 lazy，详见 help reclaim");
+            assert(args.back() == "on" || args.back() == "off", "Terminal::reclaim", "第二个参数必须为 on 或 off");
+            controller.setLazyDelete(args.back() == "on");
+        } else if (argSize == 1 && args.front() == "flush") {
+            controller.flushReclaim();
+        } else if (argSize == 1) {
+            assert(args.front() == "status", "Terminal::reclaim", "未知参数，详见 help reclaim");
+        }
+
+        auto status = controller.reclaimStatus();
+
+        os << "延迟删除：" << (controller.lazyDelete() ? "开启" : "关闭") << endl;
+        os << "  待扫描子树：" << status.queuedTrees << " 棵";
+        if (status.queuedTrees > 0) os << "，至少 " << status.queuedBytes << " 字节（扫描后确定）";
+        os << (status.scanning ? "（正在扫描）" : "") << endl;
+        os << "  待回收：" << status.pendingNodes << " 个节点，" << status.pendingBytes << " 字节" << endl;
+        os << "  已回收：" << status.freedBytes << " 字节" << endl;
     }
 
+    void Terminal::pack(const std::list<std::string> &args) {
+        assertConnection();
+        auto argSize = assertArgSize(args, {0, 1}, "pack");
+
+        if (argSize == 1) {
+            u_int64 threshold = 0;
+
+            if (args.front() != "off") {
+                try {
+                    threshold = parseSizeString(args.front());
+                } catch (size_format_error &) {
+                    throw Error{"Terminal::pack", "非法的大小输入（需要带单位，如 512B）: " + args.front()};
+                } catch (std::exception &) {
+                    throw Error{"Terminal::pack", "非法的大小输入: " + args.front()};
+                }
+            }
+
+            controller.setPackThreshold(threshold);
+        }
+
+        auto threshold = controller.packThreshold();
+
+        if (threshold == 0) {
+            os << "小文件打包：关闭" << endl;
+        } else {
+            os << "小文件打包：不超过 " << threshold << " 字节的文件" << endl;
+        }
+    }
+
+    void Terminal::layout(const std::list<std::string> &args) {
+        assertConnection();
+        auto argSize = assertArgSize(args, {0, 1, 2}, "layout");
+
+        if (argSize == 2) {
+            assert(args.front() == "align", "Terminal::layout", "首个参数必须为 align，详见 help layout");
+            assert(args.back() == "on" || args.back() == "off", "Terminal::layout", "第二个参数必须为 on 或 off");
+            controller.setAlignedData(args.back() == "on");
+        } else if (argSize == 1) {
+            assert(args.front() == "split" || args.front() == "mixed", "Terminal::layout", "参数必须为 split 或 mixed");
+            controller.migrateLayout(args.front() == "split");
+            os << "重建完成！" << endl;
+            resetUrl();
+        }
+
+        auto stats = controller.getLayoutStats();
+
+        os << "布局：" << (controller.splitMetadata() ? "元数据分离" : "inode 与内容相邻")
+           << (controller.alignedData() ? "，内容对齐" : "")
+           << (controller.compactOffsets() ? "，紧凑格式（4 字节偏移）" : "") << endl;
+        os << "  元数据节点：" << stats.metadataNodes << " 个，共 " << stats.metadataBytes << " 字节" << endl;
+        os << "  分布在 " << stats.metadataPages << " 个 " << FSController::LAYOUT_PAGE_SIZE << " 字节的页中，跨越 "
+           << stats.metadataSpan << " 页（镜像共 " << stats.totalPages << " 页）" << endl;
+        os << "  同级项目平均距离：" << stats.averageSiblingDistance() << " 字节" << endl;
+    }
+
+    void Terminal::io(const std::list<std::string> &args) {
+        assertConnection();
+        auto argSize = assertArgSize(args, {0, 2}, "io");
+
+        if (argSize == 2) {
+            assert(args.front() == "direct", "Terminal::io", "首个参数必须为 direct，详见 help io");
+            assert(args.back() == "on" || args.back() == "off", "Terminal::io", "第二个参数必须为 on 或 off");
+            controller.setDirectIO(args.back() == "on");
+        }
+
+        os << "直接 I/O：" << (controller.directIO() ? "开启" : "关闭")
+           << "（不小于 " << FileLinker::DIRECT_MIN_SIZE << " 字节的导入、导出与读取绕过页缓存）" << endl;
+    }
+
+    void Terminal::stats(const std::list<std::string> &args) {
+        assertConnection();
+        assertArgSize(args, {0}, "stats");
+
+        auto indexStats = controller.getFolderIndexStats();
+        auto negatives = indexStats.filtered + indexStats.falsePositives;
+
+        os << "目录名称过滤器：" << endl;
+        os << "  已加载目录数：" << indexStats.folders << endl;
+        os << "  平均每目录位图：" << (indexStats.folders == 0 ? 0 : indexStats.bloomBytes / indexStats.folders)
+           << " 字节（磁盘上每个目录占用 " << FOLDER_DATA_SIZE - FOLDER_TAIL_OFFSET << " 字节）" << endl;
+        os << "  不存在查询：" << negatives << " 次，过滤器直接排除 " << indexStats.filtered << " 次，误判 "
+           << indexStats.falsePositives << " 次" << endl;
+        os << "  误判率：" << (negatives == 0 ? 0.0 : 100.0 * (double) indexStats.falsePositives / (double) negatives)
+           << "%" << endl;
+    }
 
-}
\ No newline at end of file
+}
@@ -68,6 +68,16 @@ namespace FileSystem {
 
         void rmdir(const std::list<std::string> &args);
 
+        void mv(const std::list<std::string> &args);
+
+        void cp(const std::list<std::string> &args);
+
+        void clone(const std::list<std::string> &args);
+
+        void importDir(const std::list<std::string> &args);
+
+        void exportDir(const std::list<std::string> &args);
+
         static void clear(const std::list<std::string> &args);
 
         void su(const std::list<std::string> &args);
@@ -82,6 +92,20 @@ namespace FileSystem {
 
         void cat(const std::list<std::string> &args);
 
+        void lease(const std::list<std::string> &args);
+
+        void stats(const std::list<std::string> &args);
+
+        void upgrade(const std::list<std::string> &args);
+
+        void reclaim(const std::list<std::string> &args);
+
+        void pack(const std::list<std::string> &args);
+
+        void layout(const std::list<std::string> &args);
+
+        void io(const std::list<std::string> &args);
+
 
         static void exit(const std::list<std::string> &args);
 
@@ -31,16 +31,16 @@ ByteArray::ByteArray(std::byte byte) {
     this->_bytes.push_back(byte);
 }
 
-ByteArray::ByteArray(const std::byte *bytes, size_t length) {
-    for (size_t i = 0; i < length; ++i) {
-        _bytes.push_back(bytes[i]);
-    }
-}
+ByteArray::ByteArray(const std::byte *bytes, size_t length) : _bytes(bytes, bytes + length) {}
 
 std::byte *ByteArray::data() {
     return _bytes.data();
 }
 
+const std::byte *ByteArray::data() const {
+    return _bytes.data();
+}
+
 ByteArray &ByteArray::append(std::byte byte) {
     _bytes.push_back(byte);
     return *this;
@@ -52,9 +52,7 @@ ByteArray &ByteArray::append(const ByteArray &bytes) {
 }
 
 ByteArray &ByteArray::append(const std::byte *bytes, u_int64 length) {
-    for (u_int64 i = 0; i < length; ++i) {
-        _bytes.push_back(bytes[i]);
-    }
+    _bytes.insert(_bytes.end(), bytes, bytes + length);
     return *this;
 }
 
@@ -63,34 +61,25 @@ u_int64 ByteArray::size() const {
 }
 
 ByteArray &ByteArray::read(std::istream &input, u_int64 size, bool reset) {
-    u_int64 originPos = input.tellg();
-    u_int64 endPos = originPos + size;
-    auto buf = char{'\0'};
-    while (input.tellg() != endPos) {
-        input.get(buf);
-        this->append(static_cast<std::byte>(buf));
-    }
+    // 一次读入到末尾，不逐字节追加
+    auto originPos = input.tellg();
+    auto oldSize = _bytes.size();
+    _bytes.resize(oldSize + size);
+    input.read(reinterpret_cast<char *>(_bytes.data() + oldSize), static_cast<std::streamsize>(size));
     if (reset) input.seekg(originPos);
     return *this;
 }
 
 ByteArray ByteArray::subByte(u_int64 from, u_int64 to) {
-    auto res = ByteArray();
-
-    for (u_int64 i = from; i < to; ++i) {
-        res.append(this->_bytes[i]);
-    }
-
-    return res;
+    return {_bytes.data() + from, to - from};
 }
 
-u_int64 ByteArray::flatSize() {
-    std::vector<std::byte> bytes{_bytes};
-    if (bytes.empty()) return 0;
-    while (static_cast<char>(bytes.back()) == '\0') {
-        bytes.pop_back();
+u_int64 ByteArray::flatSize() const {
+    auto size = _bytes.size();
+    while (size > 0 && _bytes[size - 1] == std::byte{'\0'}) {
+        size--;
     }
-    return bytes.size();
+    return size;
 }
 
 std::vector<std::byte>::const_iterator ByteArray::cbegin() {
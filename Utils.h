@@ -29,7 +29,10 @@ public:
 
     std::byte *data();
 
-    u_int64 flatSize();
+    [[nodiscard]] const std::byte *data() const;
+
+    // 去掉末尾填充的 \0 后的大小
+    [[nodiscard]] u_int64 flatSize() const;
 
     ByteArray &append(const std::byte *bytes, u_int64 length);
 
@@ -55,6 +58,8 @@ class IByteable {
 
 public:
 
+    virtual ~IByteable() = default;
+
     virtual ByteArray toBytes() {
         return {};
     };
@@ -65,11 +70,11 @@ public:
     }
 
     template<class T>
-    static T fromBytes(ByteArray array) {
+    static T fromBytes(const ByteArray &array) {
         static_assert(std::is_trivially_copyable<T>::value, "Type T must be trivially copyable");
-        T *result = reinterpret_cast<T *>(malloc(sizeof(T)));
-        std::memcpy(result, array.data(), sizeof(T));
-        return *result;
+        T result;
+        std::memcpy(&result, array.data(), sizeof(T));
+        return result;
     }
 };
 
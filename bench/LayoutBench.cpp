@@ -0,0 +1,148 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+// 元数据分离布局的基准：以相同顺序在 inode 与内容相邻存放的镜像和元数据分离的镜像中建立同一棵目录树，
+// 各个目录的文件交替写入，再比较按 ls -R 的方式只读取名称遍历整棵树的耗时。
+// Linux 下另外测量页缓存被清空后的首次遍历，此时元数据在镜像中的分布决定需要读取的页数
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "FSController.h"
+
+using namespace FileSystem;
+
+namespace {
+
+    template<class F>
+    double timeMs(F &&f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 与 ls -R 相同：逐层列出目录，只读取名称，返回遍历到的项目数
+    std::size_t walk(FSController &controller) {
+        std::size_t visited = 0;
+        std::list<std::list<std::string>> pending{{}};
+
+        while (!pending.empty()) {
+            auto folder = std::move(pending.front());
+            pending.pop_front();
+
+            for (const auto &inode: controller.getDir(folder, false)) {
+                visited++;
+                if (inode.getType() == INode::Folder) {
+                    auto child = folder;
+                    child.push_back(inode.name);
+                    pending.push_back(std::move(child));
+                }
+            }
+        }
+
+        return visited;
+    }
+
+    // 将镜像写回磁盘并丢弃其页缓存，不支持时返回 false
+    bool dropCache(const std::string &path) {
+#ifdef __linux__
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        ::fdatasync(fd);
+        auto res = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+        return res == 0;
+#else
+        return false;
+#endif
+    }
+
+    struct Result {
+        std::size_t visited{};
+        double coldMs{-1};
+        double warmMs{};
+        u_int64 metadataPages{};
+        u_int64 metadataSpan{};
+    };
+
+    Result run(const std::string &path, bool split, std::size_t folders, std::size_t files, std::size_t fileSize) {
+
+        FSController controller{};
+        controller.create(u_int64{folders} * files * (fileSize + 512) * 2 + (u_int64{16} << 20), path, "bench");
+
+        if (split) controller.migrateLayout(true);
+
+        for (std::size_t i = 0; i < folders; i++) {
+            controller.createDir({}, "d" + std::to_string(i));
+        }
+
+        // 各目录的文件交替写入，相邻布局中同一目录的项目被其他目录的文件内容隔开
+        ByteArray data(std::vector<std::byte>(fileSize, std::byte{'x'}).data(), fileSize);
+        for (std::size_t k = 0; k < files; k++) {
+            for (std::size_t i = 0; i < folders; i++) {
+                controller.createFile({"d" + std::to_string(i)}, "f" + std::to_string(k), data);
+            }
+        }
+
+        Result res{};
+
+        auto stats = controller.getLayoutStats();
+        res.metadataPages = stats.metadataPages;
+        res.metadataSpan = stats.metadataSpan;
+
+        if (dropCache(path)) {
+            res.coldMs = timeMs([&] { res.visited = walk(controller); });
+        } else {
+            walk(controller);
+        }
+
+        // 页缓存与目录索引均已加载后，多次遍历取平均
+        const int rounds = 10;
+        res.warmMs = timeMs([&] {
+            for (int r = 0; r < rounds; r++) res.visited = walk(controller);
+        }) / rounds;
+
+        return res;
+    }
+
+    void print(const std::string &title, const Result &res) {
+        std::cout << "  " << title << "：元数据分布在 " << res.metadataPages << " 页（跨度 " << res.metadataSpan << " 页），";
+        if (res.coldMs >= 0) std::cout << "冷缓存 " << res.coldMs << " ms，";
+        std::cout << "热缓存 " << res.warmMs << " ms" << std::endl;
+    }
+
+}
+
+int main(int argc, char **argv) {
+
+    std::size_t folders = argc > 1 ? std::stoull(argv[1]) : 64;
+    std::size_t files = argc > 2 ? std::stoull(argv[2]) : 64;
+    std::size_t fileSize = argc > 3 ? std::stoull(argv[3]) : 16 * 1024;
+
+    assert(fileSize >= DiskEntity::SPLIT_MIN_SIZE, "LayoutBench",
+           "文件大小需要不小于 " + std::to_string(DiskEntity::SPLIT_MIN_SIZE) + " 字节，否则不会与元数据分离");
+
+    auto dir = std::filesystem::temp_directory_path();
+    auto mixedPath = (dir / "layout_bench_mixed.img").string();
+    auto splitPath = (dir / "layout_bench_split.img").string();
+
+    auto mixed = run(mixedPath, false, folders, files, fileSize);
+    auto split = run(splitPath, true, folders, files, fileSize);
+
+    std::filesystem::remove(mixedPath);
+    std::filesystem::remove(splitPath);
+
+    std::cout << folders << " 个目录，每个目录 " << files << " 个 " << fileSize << " 字节的文件，遍历 "
+              << mixed.visited << " 个项目" << std::endl;
+    print("相邻布局", mixed);
+    print("分离布局", split);
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+// 名称哈希的基准：目录中的项目名称共享很长的公共前缀时，
+// 比较按名称哈希跳过不匹配项目（DiskEntity::matchNameAt）与逐个解析 inode 后比较完整名称的查找耗时
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#include "DiskEntity.h"
+
+using namespace FileSystem;
+
+namespace {
+
+    std::string entryName(const std::string &prefix, std::size_t index) {
+        return prefix + std::to_string(index);
+    }
+
+    template<class F>
+    double timeMs(F &&f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+}
+
+int main(int argc, char **argv) {
+
+    std::size_t count = argc > 1 ? std::stoull(argv[1]) : 2000;
+    std::size_t prefixSize = argc > 2 ? std::stoull(argv[2]) : 200;
+
+    assert(prefixSize + std::to_string(count).size() <= 0xff, "NameHashBench", "名称过长");
+
+    auto path = (std::filesystem::temp_directory_path() / "name_hash_bench.img").string();
+    std::string prefix(prefixSize, 'a');
+
+    DiskEntity disk{u_int64{64} << 20, path, "bench"};
+
+    // 逆序分配，每个项目分配时下一个同级项目已经确定
+    u_int64 head = UNDEFINED;
+    for (auto i = count; i-- > 0;) {
+        head = disk.addFile(INode{entryName(prefix, i), 0, INode::OpenPermission, INode::FILE_TYPE, 0, head},
+                            ByteArray(), head);
+        assert(head != UNDEFINED, "NameHashBench", "镜像空间不足");
+    }
+
+    // 依次查找均匀分布的若干项目，平均每次查找扫描一半的目录
+    const std::size_t lookups = 50;
+    std::size_t visited = 0;
+
+    auto byHash = [&]() {
+        for (std::size_t k = 0; k < lookups; k++) {
+            auto name = entryName(prefix, k * count / lookups);
+            auto nameHash = INode::hashName(name);
+            for (auto position = head; position != UNDEFINED;) {
+                u_int64 next;
+                visited++;
+                if (disk.matchNameAt(position, name, nameHash, next)) break;
+                position = next;
+            }
+        }
+    };
+
+    auto byFullName = [&]() {
+        for (std::size_t k = 0; k < lookups; k++) {
+            auto name = entryName(prefix, k * count / lookups);
+            for (auto position = head; position != UNDEFINED;) {
+                auto inode = disk.fileINodeAt(position);
+                visited++;
+                if (inode.name == name) break;
+                position = inode.next;
+            }
+        }
+    };
+
+    // 先各运行一次预热页缓存
+    byHash();
+    byFullName();
+
+    visited = 0;
+    auto hashMs = timeMs(byHash);
+    auto hashVisited = visited;
+
+    visited = 0;
+    auto fullMs = timeMs(byFullName);
+    auto fullVisited = visited;
+
+    std::filesystem::remove(path);
+
+    std::cout << count << " 个项目，公共前缀 " << prefixSize << " 字节，" << lookups << " 次查找" << std::endl;
+    std::cout << "  名称哈希：    " << hashMs << " ms（" << hashMs * 1e6 / (double) hashVisited << " ns / 项目）"
+              << std::endl;
+    std::cout << "  完整名称比较：" << fullMs << " ms（" << fullMs * 1e6 / (double) fullVisited << " ns / 项目）"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+//
+// Created by actre on 10/19/2026.
+//
+
+// 编辑路径的复制计数：编辑一个 100MB 的文件，统计读出与写回时分配的大块内存。
+// 文件内容的每一次复制都需要一块与之等大的缓冲区，大块分配的次数与字节数即复制的次数与字节数；
+// 移动只转移缓冲区，不产生新的分配。每个字节在每个方向上至多复制一次；
+// 改名与切换布局只搬运镜像中的数据，不应把文件内容整体读入内存
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "FSController.h"
+
+using namespace FileSystem;
+
+namespace {
+
+    const std::size_t PAYLOAD_SIZE = 100 * 1024 * 1024;
+
+    // 不小于该值的分配视为一次文件内容的复制，远大于 I/O 缓冲区与增量写回的块
+    const std::size_t LARGE_ALLOCATION = 16 * 1024 * 1024;
+
+    std::atomic<std::size_t> largeCount{0};
+    std::atomic<std::size_t> largeBytes{0};
+
+    void resetCounters() {
+        largeCount = 0;
+        largeBytes = 0;
+    }
+
+    int failures = 0;
+
+    void check(bool condition, const std::string &what) {
+        std::cout << (condition ? "  通过：" : "  失败：") << what << std::endl;
+        if (!condition) failures++;
+    }
+
+    void report(const std::string &stage) {
+        std::cout << stage << "：" << largeCount << " 次大块分配，共 " << largeBytes << " 字节" << std::endl;
+    }
+
+}
+
+void *operator new(std::size_t size) {
+    if (size >= LARGE_ALLOCATION) {
+        largeCount++;
+        largeBytes += size;
+    }
+    if (auto *ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+int main() {
+
+    auto dir = std::filesystem::temp_directory_path() / "edit_copy_test";
+    std::filesystem::create_directories(dir);
+
+    auto hostPath = (dir / "payload.bin").string();
+    auto imagePath = (dir / "image.img").string();
+
+    {
+        std::ofstream host{hostPath, std::ios::out | std::ios::trunc | std::ios::binary};
+        std::vector<char> chunk(1024 * 1024);
+        for (std::size_t i = 0; i < PAYLOAD_SIZE / chunk.size(); i++) {
+            std::fill(chunk.begin(), chunk.end(), static_cast<char>('a' + i % 26));
+            host.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        }
+    }
+
+    {
+        FSController controller{};
+        controller.create(3 * PAYLOAD_SIZE, imagePath, "pw");
+        controller.uploadFile(hostPath, {}, "big", INode::OpenPermission);
+
+        // 读出：镜像中的内容读入一块缓冲区后移入编辑会话，不再复制
+        resetCounters();
+        auto *session = new FSController::EditSession{controller.editFile({"big"})};
+        report("读出");
+        check(largeCount == 1 && largeBytes == PAYLOAD_SIZE, "读出时文件内容只复制一次");
+        check(session->getFileData().size() == PAYLOAD_SIZE, "编辑会话持有完整的文件内容");
+
+        // 调用者的新内容：修改中间的若干字节，大小不变，写回时只写入变化的块
+        ByteArray newData{session->getFileData().data(), PAYLOAD_SIZE};
+        for (std::size_t i = 0; i < 16; i++) {
+            reinterpret_cast<char *>(newData.data())[PAYLOAD_SIZE / 2 + i] = '#';
+        }
+
+        resetCounters();
+        session->assignEditFinish(newData);
+        report("原位写回");
+        check(largeCount == 0, "原位写回时不复制整个文件内容");
+        delete session;
+
+        // 内容变大时重新分配节点，新内容仍按引用直接写入镜像
+        session = new FSController::EditSession{controller.editFile({"big"})};
+        newData.append(std::byte{'!'});
+
+        resetCounters();
+        session->assignEditFinish(newData);
+        report("重新分配写回");
+        check(largeCount == 0, "重新分配写回时不复制整个文件内容");
+        delete session;
+
+        // 名称长度改变时新建目录项指向原有的数据
+        resetCounters();
+        controller.move({"big"}, {"renamed"});
+        report("改名");
+        check(largeCount == 0, "改名时不读入文件内容");
+
+        // 按新布局重建镜像时文件内容在两个镜像之间分块搬运
+        resetCounters();
+        controller.migrateLayout(true);
+        report("切换布局");
+        check(largeCount == 0, "切换布局时不整体读入文件内容");
+
+        // 写回、改名与重建之后的内容与调用者给出的一致
+        session = new FSController::EditSession{controller.editFile({"renamed"})};
+        const auto &saved = session->getFileData();
+        check(saved.size() == newData.size() &&
+              std::memcmp(saved.data(), newData.data(), newData.size()) == 0, "写回的内容正确");
+        session->cancelEdit();
+        delete session;
+    }
+
+    std::filesystem::remove_all(dir);
+
+    return failures == 0 ? 0 : 1;
+}